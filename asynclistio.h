@@ -0,0 +1,623 @@
+#pragma once
+
+#include "fastallocator.h"
+#include "listserialization.h"
+#include "parallellist.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define LIST_HAS_IO_URING 1
+#endif
+#endif
+
+/*
+ *
+ *      Асинхронная загрузка и выгрузка List
+ *
+ *      Файл читается/пишется несколькими буферами по кругу: пока ядро
+ * читает следующий буфер, мы разбираем текущий и выделяем под него узлы.
+ * При записи наоборот - пока пишется один буфер, заполняем другой
+ *
+ *      Под Linux это io_uring (через сырые системные вызовы, без liburing),
+ * а если его нет или ядро не дало (старое ядро, seccomp в контейнере) -
+ * pread/pwrite в пуле потоков из parallellist.h
+ *
+ *      Формат файла тот же, что у save_list/load_list
+ *
+ */
+
+/*
+ *
+ *      AsyncFile
+ *
+ *      Файл с фиксированным числом слотов. В каждом слоте может висеть
+ * одна операция: submit_* ее запускает, wait() дожидается
+ *
+ */
+
+struct AsyncFile {
+private:
+    struct Slot_ {
+        bool write = false;
+        char *data = nullptr;
+        size_t size = 0;
+        uint64_t offset = 0;
+        struct iovec iov;
+
+        bool busy = false;
+        bool pooled = false;  // выполняется в пуле потоков, а не в кольце
+        std::atomic<bool> done{false};
+        ssize_t result = 0;
+    };
+
+    int fd_;
+    std::vector<std::unique_ptr<Slot_>> slots_;
+
+#ifdef LIST_HAS_IO_URING
+    int ring_fd_ = -1;
+    void *sq_ring_ = MAP_FAILED;
+    void *cq_ring_ = MAP_FAILED;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    struct io_uring_sqe *sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_mask_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned *cq_mask_ = nullptr;
+    struct io_uring_cqe *cqes_ = nullptr;
+
+    // sqe уже в очереди, но ядро их еще не забрало
+    unsigned unsubmitted_ = 0;
+
+    bool setup_ring_(unsigned entries);
+    void close_ring_();
+    void submit_ring_(size_t slot);
+    void flush_ring_();
+    void reap_ring_();
+#endif
+
+    void submit_(size_t slot);
+    void submit_pool_(size_t slot);
+    ssize_t finish_sync_(Slot_ &, ssize_t done);
+
+public:
+    AsyncFile(int fd, size_t slots, bool use_io_uring = true);
+    ~AsyncFile();
+
+    AsyncFile(const AsyncFile &) = delete;
+    AsyncFile &operator=(const AsyncFile &) = delete;
+
+    bool uses_io_uring() const;
+
+    void submit_read(size_t slot, void *data, size_t size, uint64_t offset);
+    void submit_write(size_t slot, const void *data, size_t size,
+                      uint64_t offset);
+
+    ssize_t wait(size_t slot);
+};
+
+inline AsyncFile::AsyncFile(int fd, size_t slots, bool use_io_uring)
+        : fd_(fd) {
+    for (size_t i = 0; i < slots; i++) {
+        slots_.emplace_back(new Slot_());
+    }
+
+#ifdef LIST_HAS_IO_URING
+    if (use_io_uring && !setup_ring_(static_cast<unsigned>(slots))) {
+        close_ring_();
+    }
+#else
+    (void)use_io_uring;
+#endif
+}
+
+inline AsyncFile::~AsyncFile() {
+    for (size_t i = 0; i < slots_.size(); i++) {
+        wait(i);
+    }
+
+#ifdef LIST_HAS_IO_URING
+    close_ring_();
+#endif
+}
+
+inline bool AsyncFile::uses_io_uring() const {
+#ifdef LIST_HAS_IO_URING
+    return ring_fd_ >= 0;
+#else
+    return false;
+#endif
+}
+
+#ifdef LIST_HAS_IO_URING
+
+/*
+ *  Создаем кольцо и отображаем в память очереди отправки и завершения
+ */
+inline bool AsyncFile::setup_ring_(unsigned entries) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd_ < 0) {
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        return false;
+    }
+
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe *>(
+        mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+inline void AsyncFile::close_ring_() {
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = MAP_FAILED;
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = MAP_FAILED;
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+/*
+ *  Слотов не больше, чем мест в очереди, так что место всегда есть
+ *  Хвост очереди двигаем с release, чтобы ядро увидело заполненный sqe
+ */
+inline void AsyncFile::submit_ring_(size_t slot) {
+    Slot_ &s = *slots_[slot];
+
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+
+    struct io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = s.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&s.iov);
+    sqe->len = 1;
+    sqe->off = s.offset;
+    sqe->user_data = slot;
+
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    ++unsubmitted_;
+    flush_ring_();
+}
+
+/*
+ *  Отдаем ядру все, что лежит в очереди
+ *  - EINTR - просто повторяем
+ *  - EAGAIN, EBUSY - ядру сейчас некуда (например, полна очередь
+ *    завершений): разбираем завершения и пробуем позже, из wait()
+ *  - любая другая ошибка - кольцо не принимает sqe. Забираем их обратно
+ *    (ядро их еще не видело: его голова очереди до них не дошла) и
+ *    выполняем в пуле потоков через pread/pwrite
+ */
+inline void AsyncFile::flush_ring_() {
+    while (unsubmitted_ > 0) {
+        long result = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted_, 0,
+                              0, nullptr, 0);
+        if (result >= 0) {
+            unsubmitted_ -= static_cast<unsigned>(result);
+            if (result == 0) {
+                return;
+            }
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY) {
+            reap_ring_();
+            return;
+        }
+
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        unsigned tail = *sq_tail_;
+        __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+        unsubmitted_ = 0;
+
+        for (unsigned i = head; i != tail; i++) {
+            struct io_uring_sqe *sqe = &sqes_[sq_array_[i & *sq_mask_]];
+            submit_pool_(static_cast<size_t>(sqe->user_data));
+        }
+        return;
+    }
+}
+
+/*
+ *  Разбираем все пришедшие завершения
+ */
+inline void AsyncFile::reap_ring_() {
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+
+        Slot_ &s = *slots_[cqe->user_data];
+        s.result = cqe->res;
+        s.done.store(true, std::memory_order_release);
+
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+#endif
+
+inline void AsyncFile::submit_(size_t slot) {
+    Slot_ &s = *slots_[slot];
+
+    s.iov.iov_base = s.data;
+    s.iov.iov_len = s.size;
+    s.busy = true;
+    s.pooled = false;
+    s.done.store(false, std::memory_order_relaxed);
+
+#ifdef LIST_HAS_IO_URING
+    if (ring_fd_ >= 0) {
+        submit_ring_(slot);
+        return;
+    }
+#endif
+
+    submit_pool_(slot);
+}
+
+inline void AsyncFile::submit_pool_(size_t slot) {
+    Slot_ &s = *slots_[slot];
+    s.pooled = true;
+
+    int fd = fd_;
+    Slot_ *target = &s;
+    ThreadPool::getThreadPool()->submit([fd, target]() {
+        ssize_t result = target->write
+            ? pwrite(fd, target->data, target->size, target->offset)
+            : pread(fd, target->data, target->size, target->offset);
+        target->result = result < 0 ? -errno : result;
+        target->done.store(true, std::memory_order_release);
+    });
+}
+
+inline void AsyncFile::submit_read(size_t slot, void *data, size_t size,
+                                   uint64_t offset) {
+    Slot_ &s = *slots_[slot];
+    s.write = false;
+    s.data = static_cast<char *>(data);
+    s.size = size;
+    s.offset = offset;
+    submit_(slot);
+}
+
+inline void AsyncFile::submit_write(size_t slot, const void *data, size_t size,
+                                    uint64_t offset) {
+    Slot_ &s = *slots_[slot];
+    s.write = true;
+    s.data = static_cast<char *>(const_cast<void *>(data));
+    s.size = size;
+    s.offset = offset;
+    submit_(slot);
+}
+
+/*
+ *  Если операция выполнилась не целиком, остаток доделываем синхронно
+ *  Для чтения короткий результат значит, что файл кончился
+ */
+inline ssize_t AsyncFile::finish_sync_(Slot_ &s, ssize_t done) {
+    while (static_cast<size_t>(done) < s.size) {
+        ssize_t result = s.write
+            ? pwrite(fd_, s.data + done, s.size - done, s.offset + done)
+            : pread(fd_, s.data + done, s.size - done, s.offset + done);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (result == 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+/*
+ *  Возвращает число байт или -errno
+ *  Пока ждем пул, помогаем ему, как TaskGroup
+ */
+inline ssize_t AsyncFile::wait(size_t slot) {
+    Slot_ &s = *slots_[slot];
+    if (!s.busy) {
+        return 0;
+    }
+
+    while (!s.done.load(std::memory_order_acquire)) {
+#ifdef LIST_HAS_IO_URING
+        if (ring_fd_ >= 0 && !s.pooled) {
+            flush_ring_();
+            reap_ring_();
+            if (s.done.load(std::memory_order_acquire) || s.pooled) {
+                continue;
+            }
+            if (unsubmitted_ > 0) {
+                std::this_thread::yield();
+            } else {
+                syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                        IORING_ENTER_GETEVENTS, nullptr, 0);
+            }
+            continue;
+        }
+#endif
+        if (!ThreadPool::getThreadPool()->try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+
+    s.busy = false;
+    if (s.result < 0) {
+        return s.result;
+    }
+    return finish_sync_(s, s.result);
+}
+
+/*
+ *
+ *      async_load_list / async_save_list
+ *
+ *      Возвращают false, если файл не открылся, формат не тот или была
+ * ошибка ввода-вывода
+ *      Конвейер есть только для тривиально копируемых T, остальные
+ * читаются/пишутся через обычные потоки
+ *
+ */
+
+static const size_t async_list_slots = 4;
+static const size_t async_list_buffer_size = 4 << 20;
+
+template <typename T, typename Allocator>
+bool async_load_list_(int fd, List<T, Allocator> &list, uint64_t count,
+                      bool use_io_uring, std::true_type) {
+    const size_t per_buffer = async_list_buffer_size / sizeof(T) + 1;
+    const size_t buffer_bytes = per_buffer * sizeof(T);
+
+    using storage_type =
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    std::vector<std::vector<storage_type>> buffers(async_list_slots);
+    for (size_t i = 0; i < async_list_slots; i++) {
+        buffers[i].resize(per_buffer);
+    }
+
+    AsyncFile file(fd, async_list_slots, use_io_uring);
+
+    uint64_t total = count * sizeof(T);
+    uint64_t submitted = 0;
+    std::vector<size_t> sizes(async_list_slots, 0);
+
+    auto submit_next = [&](size_t slot) {
+        sizes[slot] = std::min<uint64_t>(total - submitted, buffer_bytes);
+        if (sizes[slot] > 0) {
+            file.submit_read(slot, buffers[slot].data(), sizes[slot],
+                             sizeof(ListStreamHeader) + submitted);
+            submitted += sizes[slot];
+        }
+    };
+
+    for (size_t slot = 0; slot < async_list_slots; slot++) {
+        submit_next(slot);
+    }
+
+    bool ok = true;
+    for (size_t slot = 0; sizes[slot] > 0; slot = (slot + 1) % async_list_slots) {
+        ssize_t result = file.wait(slot);
+        if (result != static_cast<ssize_t>(sizes[slot])) {
+            ok = false;
+            break;
+        }
+
+        const T *first = reinterpret_cast<const T *>(buffers[slot].data());
+        list.insert(list.cend(), first, first + sizes[slot] / sizeof(T));
+
+        submit_next(slot);
+    }
+
+    for (size_t slot = 0; slot < async_list_slots; slot++) {
+        file.wait(slot);
+    }
+    return ok;
+}
+
+template <typename T, typename Allocator>
+bool async_save_list_(int fd, const List<T, Allocator> &list,
+                      bool use_io_uring, std::true_type) {
+    const size_t per_buffer = async_list_buffer_size / sizeof(T) + 1;
+
+    std::vector<std::vector<char>> buffers(async_list_slots);
+    for (size_t i = 0; i < async_list_slots; i++) {
+        buffers[i].resize(per_buffer * sizeof(T));
+    }
+
+    AsyncFile file(fd, async_list_slots, use_io_uring);
+
+    bool ok = true;
+    uint64_t offset = sizeof(ListStreamHeader);
+    std::vector<size_t> sizes(async_list_slots, 0);
+
+    auto it = list.cbegin();
+    size_t slot = 0;
+    for (size_t done = 0; done < list.size();
+         slot = (slot + 1) % async_list_slots) {
+        if (sizes[slot] > 0 &&
+            file.wait(slot) != static_cast<ssize_t>(sizes[slot])) {
+            ok = false;
+            break;
+        }
+
+        size_t take = std::min(list.size() - done, per_buffer);
+        char *position = buffers[slot].data();
+        for (size_t i = 0; i < take; i++, ++it) {
+            std::memcpy(position, &*it, sizeof(T));
+            position += sizeof(T);
+        }
+
+        sizes[slot] = take * sizeof(T);
+        file.submit_write(slot, buffers[slot].data(), sizes[slot], offset);
+        offset += sizes[slot];
+        done += take;
+    }
+
+    for (size_t i = 0; i < async_list_slots; i++) {
+        if (sizes[i] > 0 && file.wait(i) != static_cast<ssize_t>(sizes[i])) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+template <typename T, typename Allocator>
+bool async_load_list_(int fd, List<T, Allocator> &, uint64_t, bool,
+                      std::false_type) {
+    (void)fd;
+    return false;
+}
+
+template <typename T, typename Allocator>
+bool async_save_list_(int fd, const List<T, Allocator> &, bool,
+                      std::false_type) {
+    (void)fd;
+    return false;
+}
+
+/*
+ *  Содержимое list заменяется содержимым файла
+ */
+template <typename T, typename Allocator>
+bool async_load_list(const char *path, List<T, Allocator> &list,
+                     bool use_io_uring = true) {
+    using raw = std::is_trivially_copyable<T>;
+    if (!raw::value) {
+        std::ifstream in(path, std::ios::binary);
+        return static_cast<bool>(load_list(in, list));
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    ListStreamHeader header;
+    bool ok = pread(fd, &header, sizeof(header), 0) ==
+                  static_cast<ssize_t>(sizeof(header)) &&
+              header.magic_ == ListStreamHeader::magic &&
+              header.version_ <= ListStreamHeader::version &&
+              header.element_size_ == sizeof(T) &&
+              (header.flags_ & ListStreamHeader::raw_elements) != 0;
+
+    if (ok) {
+        list.clear();
+        ok = async_load_list_(fd, list, header.count_, use_io_uring, raw());
+    }
+
+    close(fd);
+    return ok;
+}
+
+template <typename T, typename Allocator>
+bool async_save_list(const char *path, const List<T, Allocator> &list,
+                     bool use_io_uring = true) {
+    using raw = std::is_trivially_copyable<T>;
+    if (!raw::value) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        return static_cast<bool>(save_list(out, list));
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    ListStreamHeader header;
+    header.magic_ = ListStreamHeader::magic;
+    header.version_ = ListStreamHeader::version;
+    header.flags_ = ListStreamHeader::raw_elements;
+    header.element_size_ = sizeof(T);
+    header.count_ = list.size();
+
+    bool ok = pwrite(fd, &header, sizeof(header), 0) ==
+                  static_cast<ssize_t>(sizeof(header)) &&
+              async_save_list_(fd, list, use_io_uring, raw());
+
+    ok = close(fd) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,449 @@
+#include "../fastallocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#include <memory_resource>
+#define BENCH_HAVE_PMR 1
+#endif
+#endif
+
+/*
+ *
+ *      Аллокаторы на разных сценариях выделения и освобождения
+ *
+ *      FastAllocator против std::allocator, malloc и (если собрано с
+ * -std=c++17) std::pmr::unsynchronized_pool_resource
+ *
+ *      Сценарий - заранее сгенерированная последовательность операций
+ * "выделить в слот i" / "освободить слот i", одна и та же для всех
+ * аллокаторов (seed фиксированный):
+ *      - lifo      - выделили окно, освободили в обратном порядке
+ *      - fifo      - кольцо: освобождаем самый старый, выделяем новый
+ *      - random    - освобождаем случайный живой, выделяем на его место
+ *      - bursty    - фон из random, время от времени всплеск выделений,
+ *                    который потом освобождается вразнобой
+ *      - prodcons  - очередь: "производитель" выделяет пачку в хвост,
+ *                    "потребитель" освобождает пачку с головы. Оба в одном
+ *                    потоке - FastAllocator однопоточный, с настоящими
+ *                    потоками смотри bench/scalability.cpp
+ *      - mixed     - random, но размеры вперемешку по всем классам
+ *      Все, кроме mixed, гоняются отдельно для каждого размера
+ *
+ *      Каждый прогон - в отдельном процессе (fork), так что пулы у всех
+ * чистые, а пиковый RSS - свой. Время меряем пачками по batch_ops
+ * операций: ns_per_op - среднее, p50/p99 - по пачкам
+ *
+ *      Вывод - CSV в stdout, чтобы сравнивать результаты между коммитами
+ *
+ *      ./allocators [ops] [window]
+ *
+ */
+
+static const size_t sizes[] = {8, 16, 32, 64, 128, 256, 1024};
+static const size_t size_classes = sizeof(sizes) / sizeof(sizes[0]);
+static const size_t batch_ops = 256;
+
+template <size_t N>
+struct Block {
+    char data[N];
+};
+
+/*
+ *  Размер - номер класса в sizes, выбор класса одинаковый для всех
+ * аллокаторов, так что switch стоит всем одинаково
+ */
+template <typename Backend>
+struct SizeDispatch {
+    void *allocate(size_t cls) {
+        Backend &self = static_cast<Backend &>(*this);
+        switch (cls) {
+            case 0: return self.template allocate_<8>();
+            case 1: return self.template allocate_<16>();
+            case 2: return self.template allocate_<32>();
+            case 3: return self.template allocate_<64>();
+            case 4: return self.template allocate_<128>();
+            case 5: return self.template allocate_<256>();
+            default: return self.template allocate_<1024>();
+        }
+    }
+
+    void deallocate(void *ptr, size_t cls) {
+        Backend &self = static_cast<Backend &>(*this);
+        switch (cls) {
+            case 0: return self.template deallocate_<8>(ptr);
+            case 1: return self.template deallocate_<16>(ptr);
+            case 2: return self.template deallocate_<32>(ptr);
+            case 3: return self.template deallocate_<64>(ptr);
+            case 4: return self.template deallocate_<128>(ptr);
+            case 5: return self.template deallocate_<256>(ptr);
+            default: return self.template deallocate_<1024>(ptr);
+        }
+    }
+};
+
+struct FastBackend : SizeDispatch<FastBackend> {
+    template <size_t N>
+    void *allocate_() {
+        return FastAllocator<Block<N> >().allocate(1);
+    }
+    template <size_t N>
+    void deallocate_(void *ptr) {
+        FastAllocator<Block<N> >().deallocate(static_cast<Block<N> *>(ptr),
+                                              1);
+    }
+};
+
+struct StdBackend : SizeDispatch<StdBackend> {
+    template <size_t N>
+    void *allocate_() {
+        return std::allocator<Block<N> >().allocate(1);
+    }
+    template <size_t N>
+    void deallocate_(void *ptr) {
+        std::allocator<Block<N> >().deallocate(static_cast<Block<N> *>(ptr),
+                                               1);
+    }
+};
+
+struct MallocBackend : SizeDispatch<MallocBackend> {
+    template <size_t N>
+    void *allocate_() {
+        return std::malloc(N);
+    }
+    template <size_t N>
+    void deallocate_(void *ptr) {
+        std::free(ptr);
+    }
+};
+
+#ifdef BENCH_HAVE_PMR
+struct PmrBackend : SizeDispatch<PmrBackend> {
+    template <size_t N>
+    void *allocate_() {
+        return resource_.allocate(N, alignof(Block<N>));
+    }
+    template <size_t N>
+    void deallocate_(void *ptr) {
+        resource_.deallocate(ptr, N, alignof(Block<N>));
+    }
+
+private:
+    std::pmr::unsynchronized_pool_resource resource_;
+};
+#endif
+
+struct Op {
+    uint32_t slot;
+    uint8_t cls;
+    bool allocate;
+};
+
+/*
+ *  Генератор помнит, какие слоты заняты и каким классом, и пишет
+ * операции до тех пор, пока их не наберется ops
+ */
+struct Trace {
+    std::vector<Op> ops;
+    std::vector<int> live_cls;  // -1 - слот пуст
+    size_t limit;
+    std::mt19937 rng;
+
+    Trace(size_t limit_ops, size_t window)
+            : live_cls(window, -1), limit(limit_ops), rng(12345) {
+        ops.reserve(limit_ops);
+    }
+
+    bool full() const { return ops.size() >= limit; }
+
+    void alloc(size_t slot, size_t cls) {
+        ops.push_back(Op{static_cast<uint32_t>(slot),
+                         static_cast<uint8_t>(cls), true});
+        live_cls[slot] = static_cast<int>(cls);
+    }
+
+    void release(size_t slot) {
+        ops.push_back(Op{static_cast<uint32_t>(slot),
+                         static_cast<uint8_t>(live_cls[slot]), false});
+        live_cls[slot] = -1;
+    }
+
+    size_t random(size_t n) { return rng() % n; }
+};
+
+static size_t mixed_class(Trace &trace) {
+    // в основном мелкие объекты, как у узлов контейнеров
+    static const unsigned weights[] = {30, 25, 20, 12, 8, 4, 1};
+    unsigned roll = static_cast<unsigned>(trace.random(100));
+    for (size_t cls = 0; cls < size_classes; cls++) {
+        if (roll < weights[cls]) {
+            return cls;
+        }
+        roll -= weights[cls];
+    }
+    return 0;
+}
+
+static void gen_lifo(Trace &t, size_t window, size_t cls) {
+    while (!t.full()) {
+        for (size_t i = 0; i < window; i++) {
+            t.alloc(i, cls);
+        }
+        for (size_t i = window; i-- > 0;) {
+            t.release(i);
+        }
+    }
+}
+
+static void gen_fifo(Trace &t, size_t window, size_t cls) {
+    for (size_t i = 0; i < window; i++) {
+        t.alloc(i, cls);
+    }
+    for (size_t i = 0; !t.full(); i = (i + 1) % window) {
+        t.release(i);
+        t.alloc(i, cls);
+    }
+}
+
+static void gen_random(Trace &t, size_t window, size_t cls, bool mixed) {
+    for (size_t i = 0; i < window; i++) {
+        t.alloc(i, mixed ? mixed_class(t) : cls);
+    }
+    while (!t.full()) {
+        size_t slot = t.random(window);
+        t.release(slot);
+        t.alloc(slot, mixed ? mixed_class(t) : cls);
+    }
+}
+
+static void gen_bursty(Trace &t, size_t window, size_t cls) {
+    size_t base = std::max<size_t>(window / 4, 1);
+    for (size_t i = 0; i < base; i++) {
+        t.alloc(i, cls);
+    }
+
+    std::vector<size_t> burst;
+    while (!t.full()) {
+        for (size_t i = 0; i < 1000; i++) {
+            size_t slot = t.random(base);
+            t.release(slot);
+            t.alloc(slot, cls);
+        }
+
+        size_t count = 1 + t.random(window - base);
+        burst.clear();
+        for (size_t i = 0; i < count; i++) {
+            t.alloc(base + i, cls);
+            burst.push_back(base + i);
+        }
+        std::shuffle(burst.begin(), burst.end(), t.rng);
+        for (size_t slot : burst) {
+            t.release(slot);
+        }
+    }
+}
+
+static void gen_prodcons(Trace &t, size_t window, size_t cls) {
+    size_t head = 0;
+    size_t tail = 0;
+    size_t queued = 0;
+    while (!t.full()) {
+        size_t produce = std::min(1 + t.random(64), window - queued);
+        for (size_t i = 0; i < produce; i++) {
+            t.alloc(tail, cls);
+            tail = (tail + 1) % window;
+        }
+        queued += produce;
+
+        size_t consume = std::min(1 + t.random(64), queued);
+        for (size_t i = 0; i < consume; i++) {
+            t.release(head);
+            head = (head + 1) % window;
+        }
+        queued -= consume;
+    }
+}
+
+struct Result {
+    double ns_per_op;
+    double p50_ns;
+    double p99_ns;
+    long rss_before_kb;
+};
+
+static long current_rss_kb() {
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return -1;
+    }
+    long pages = 0;
+    long resident = 0;
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    std::fclose(statm);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+template <typename Backend>
+static Result replay(const std::vector<Op> &ops, size_t window) {
+    Backend backend;
+    std::vector<void *> slots(window, nullptr);
+    std::vector<double> batches;
+    batches.reserve(ops.size() / batch_ops + 1);
+
+    Result result;
+    result.rss_before_kb = current_rss_kb();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t begin = 0; begin < ops.size(); begin += batch_ops) {
+        size_t end = std::min(begin + batch_ops, ops.size());
+        auto batch_start = std::chrono::steady_clock::now();
+        for (size_t i = begin; i < end; i++) {
+            const Op &op = ops[i];
+            if (op.allocate) {
+                void *ptr = backend.allocate(op.cls);
+                *static_cast<volatile char *>(ptr) = 1;
+                slots[op.slot] = ptr;
+            } else {
+                backend.deallocate(slots[op.slot], op.cls);
+                slots[op.slot] = nullptr;
+            }
+        }
+        std::chrono::duration<double, std::nano> time =
+            std::chrono::steady_clock::now() - batch_start;
+        batches.push_back(time.count() / (end - begin));
+    }
+    std::chrono::duration<double, std::nano> total =
+        std::chrono::steady_clock::now() - start;
+
+    // что осталось живым, не освобождаем: процесс все равно сейчас
+    // завершится
+
+    std::sort(batches.begin(), batches.end());
+    result.ns_per_op = total.count() / ops.size();
+    result.p50_ns = batches[batches.size() / 2];
+    result.p99_ns = batches[batches.size() * 99 / 100];
+    return result;
+}
+
+static std::vector<Op> make_trace(const std::string &pattern, size_t cls,
+                                  size_t ops, size_t window) {
+    Trace trace(ops, window);
+    if (pattern == "lifo") {
+        gen_lifo(trace, window, cls);
+    } else if (pattern == "fifo") {
+        gen_fifo(trace, window, cls);
+    } else if (pattern == "random") {
+        gen_random(trace, window, cls, false);
+    } else if (pattern == "bursty") {
+        gen_bursty(trace, window, cls);
+    } else if (pattern == "prodcons") {
+        gen_prodcons(trace, window, cls);
+    } else {
+        gen_random(trace, window, cls, true);
+    }
+    return trace.ops;
+}
+
+/*
+ *  Прогон в дочернем процессе: результат - через pipe, пиковый RSS -
+ * из wait4
+ */
+static void run(const std::string &allocator, const std::string &pattern,
+                size_t cls, size_t ops, size_t window) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(1);
+    }
+
+    if (child == 0) {
+        close(fds[0]);
+        std::vector<Op> trace = make_trace(pattern, cls, ops, window);
+
+        Result result;
+        if (allocator == "fast") {
+            result = replay<FastBackend>(trace, window);
+        } else if (allocator == "std") {
+            result = replay<StdBackend>(trace, window);
+#ifdef BENCH_HAVE_PMR
+        } else if (allocator == "pmr_pool") {
+            result = replay<PmrBackend>(trace, window);
+#endif
+        } else {
+            result = replay<MallocBackend>(trace, window);
+        }
+
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    Result result;
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    wait4(child, &status, 0, &usage);
+    if (got != static_cast<ssize_t>(sizeof(result)) || status != 0) {
+        std::fprintf(stderr, "%s/%s failed\n", allocator.c_str(),
+                     pattern.c_str());
+        return;
+    }
+
+    std::printf("%s,%s,%s,%zu,%.2f,%.2f,%.2f,%ld,%ld\n", allocator.c_str(),
+                pattern.c_str(),
+                pattern == "mixed" ? "mixed"
+                                   : std::to_string(sizes[cls]).c_str(),
+                ops, result.ns_per_op, result.p50_ns, result.p99_ns,
+                usage.ru_maxrss, usage.ru_maxrss - result.rss_before_kb);
+    std::fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    size_t ops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    size_t window = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000;
+    window = std::max<size_t>(window, 2);
+
+    std::vector<std::string> allocators = {"fast", "std", "malloc"};
+#ifdef BENCH_HAVE_PMR
+    allocators.push_back("pmr_pool");
+#endif
+    const char *patterns[] = {"lifo", "fifo", "random", "bursty", "prodcons"};
+
+    std::printf("allocator,pattern,size,ops,ns_per_op,p50_ns,p99_ns,"
+                "peak_rss_kb,rss_growth_kb\n");
+    for (const char *pattern : patterns) {
+        for (size_t cls = 0; cls < size_classes; cls++) {
+            for (const std::string &allocator : allocators) {
+                run(allocator, pattern, cls, ops, window);
+            }
+        }
+    }
+    for (const std::string &allocator : allocators) {
+        run(allocator, "mixed", 0, ops, window);
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "../compressedlist.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/*
+ *
+ *      Сколько памяти на элемент тратит CompressedList
+ *
+ *      Три сценария на почти монотонных id (разности 1..64):
+ *      - append  - только push_back
+ *      - middle  - половина push_back, остальное вставляется в одну и ту
+ *                  же точку в середине
+ *      - mixed   - случайные вставки и удаления у бродячего курсора
+ *
+ *      Для каждого печатаем байты на элемент и сравниваем число блоков с
+ * тем же содержимым, собранным заново через push_back (там блоки
+ * заполнены до конца). fill = плотные блоки / наши блоки. Если где-то
+ * fill меньше половины, выходим с кодом 1: значит, вставки в середину
+ * опять режут блоки на мелкие
+ *
+ *      ./compressedlist [elements]
+ *
+ *      Вывод - CSV
+ *
+ */
+
+struct XorShift {
+    uint64_t state;
+
+    explicit XorShift(uint64_t seed) : state(seed) {}
+
+    uint64_t operator()() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+typedef CompressedList<uint64_t> Compressed;
+
+static void build_append(Compressed &list, size_t elements, XorShift &rng) {
+    uint64_t id = 0;
+    for (size_t i = 0; i < elements; i++) {
+        id += 1 + rng() % 64;
+        list.push_back(id);
+    }
+}
+
+/*
+ *  Вставляем все время перед одним и тем же элементом - он уезжает
+ * вправо, а блок перед ним раз за разом переполняется
+ */
+static void build_middle(Compressed &list, size_t elements, XorShift &rng) {
+    build_append(list, elements / 2, rng);
+
+    Compressed::const_iterator where = list.begin();
+    for (size_t i = 0; i < elements / 4; i++) {
+        ++where;
+    }
+    uint64_t id = *where;
+    for (size_t i = list.size(); i < elements; i++) {
+        id -= rng() % 2;
+        list.insert(where, id);
+    }
+}
+
+/*
+ *  Итератор после insert и erase не портится только у вставленного или
+ * следующего за удаленным элемента, так что курсор ведем через них
+ */
+static void build_mixed(Compressed &list, size_t elements, XorShift &rng) {
+    build_append(list, elements / 2, rng);
+
+    Compressed::const_iterator cursor = list.begin();
+    for (size_t op = 0; op < 4 * elements; op++) {
+        uint64_t roll = rng();
+        for (uint64_t step = roll % 8; step > 0 && cursor != list.end();
+             step--) {
+            ++cursor;
+        }
+        if (cursor == list.end()) {
+            cursor = list.begin();
+        }
+
+        if (list.size() < elements && (roll >> 8) % 3 != 0) {
+            cursor = list.insert(cursor, *cursor - (roll >> 16) % 2);
+        } else if (list.size() > 1) {
+            cursor = list.erase(cursor);
+        }
+    }
+}
+
+static bool report(const char *scenario, const Compressed &list) {
+    Compressed packed(list);
+    double fill = double(packed.block_count()) / list.block_count();
+    std::printf("%s,%zu,%zu,%.2f,%zu,%.2f\n", scenario, list.size(),
+                list.block_count(), double(list.memory_usage()) / list.size(),
+                packed.block_count(), fill);
+    return fill >= 0.5;
+}
+
+int main(int argc, char **argv) {
+    size_t elements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    if (elements < 16) {
+        elements = 16;
+    }
+
+    bool ok = true;
+    std::printf("scenario,elements,blocks,bytes_per_elem,packed_blocks,fill\n");
+    {
+        XorShift rng(42);
+        Compressed list;
+        build_append(list, elements, rng);
+        ok = report("append", list) && ok;
+    }
+    {
+        XorShift rng(42);
+        Compressed list;
+        build_middle(list, elements, rng);
+        ok = report("middle", list) && ok;
+    }
+    {
+        XorShift rng(42);
+        Compressed list;
+        build_mixed(list, elements, rng);
+        ok = report("mixed", list) && ok;
+    }
+
+    if (!ok) {
+        std::fprintf(stderr, "блоки заполнены меньше чем наполовину\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,495 @@
+#include "../fastallocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *
+ *      Контейнеры с FastAllocator против std::allocator
+ *
+ *      README обещает, что List и std::list со своим аллокатором на
+ * случайных вставках и удалениях хотя бы на 10% быстрее, чем со
+ * стандартным. Здесь это и меряется, плюс std::map, std::set и
+ * std::unordered_map, для элементов от 1 байта до 1 КиБ и для
+ * контейнеров от 10 элементов
+ *
+ *      Сценарий:
+ *      - построить контейнер из size элементов
+ *      - ops случайных удалений и вставок: в листах - у курсора, который
+ *        бродит по листу, в map/set/unordered_map - по случайному ключу
+ *      - разрушить контейнер
+ *      ns_per_op - все время, деленное на число операций, лучший из reps
+ *      Каждый сценарий - в отдельном процессе, чтобы пулы FixedAllocator
+ * от прошлых сценариев не влияли на следующие
+ *
+ *      Результаты - JSON (одна запись на строку), у упавшего сценария
+ * ns_per_op = -1. С --baseline сравниваем с сохраненным прогоном и
+ * выходим с кодом 1, если хоть один сценарий стал медленнее больше чем на
+ * threshold процентов, упал или вообще не запускался (так что флаги
+ * размеров должны совпадать с теми, что были у baseline)
+ *
+ *      ./containers [--sizes 10,1000,100000,1000000] [--elems 1,8,64,256,1024]
+ *                   [--reps 3] [--max-bytes 268435456]
+ *                   [--out result.json] [--baseline old.json]
+ *                   [--threshold 10]
+ *
+ */
+
+template <size_t N>
+struct Elem {
+    unsigned char data[N];
+
+    Elem() { std::memset(data, 0, N); }
+    explicit Elem(uint64_t key) {
+        std::memset(data, 0, N);
+        std::memcpy(data, &key, std::min(N, sizeof(key)));
+    }
+
+    uint64_t key() const {
+        uint64_t key = 0;
+        std::memcpy(&key, data, std::min(N, sizeof(key)));
+        return key;
+    }
+
+    bool operator<(const Elem &rhs) const { return key() < rhs.key(); }
+};
+
+/*
+ *  Дешевый генератор, одинаковый для обоих аллокаторов
+ */
+struct XorShift {
+    uint64_t state;
+
+    explicit XorShift(uint64_t seed) : state(seed) {}
+
+    uint64_t operator()() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+ *  Лист: курсор ходит на пару шагов вперед, у курсора удаляем или
+ * вставляем
+ */
+template <typename Sequence, size_t N>
+double run_sequence(size_t size, size_t ops) {
+    XorShift rng(size * 7919 + N);
+    auto start = Clock::now();
+    {
+        Sequence list;
+        for (size_t i = 0; i < size; i++) {
+            list.push_back(Elem<N>(rng()));
+        }
+
+        auto cursor = list.begin();
+        for (size_t i = 0; i < ops; i++) {
+            uint64_t roll = rng();
+            for (uint64_t step = (roll >> 1) & 3; step > 0; step--) {
+                if (cursor == list.end()) {
+                    break;
+                }
+                ++cursor;
+            }
+            if (cursor == list.end()) {
+                cursor = list.begin();
+            }
+
+            if ((roll & 1) && cursor != list.end()) {
+                cursor = list.erase(cursor);
+            } else {
+                cursor = list.insert(cursor, Elem<N>(roll));
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> time = Clock::now() - start;
+    return time.count() / (2 * size + ops);
+}
+
+/*
+ *  Ассоциативные: удаляем случайный живой ключ и вставляем новый
+ */
+template <typename Map, typename MakeValue, typename MakeKey>
+double run_keyed(size_t size, size_t ops, uint64_t seed, MakeValue make_value,
+                 MakeKey make_key) {
+    XorShift rng(seed);
+    std::vector<uint64_t> keys(size);
+    for (size_t i = 0; i < size; i++) {
+        keys[i] = rng();
+    }
+
+    auto start = Clock::now();
+    {
+        Map map;
+        for (size_t i = 0; i < size; i++) {
+            map.insert(make_value(keys[i]));
+        }
+
+        for (size_t i = 0; i < ops; i++) {
+            uint64_t &key = keys[rng() % size];
+            map.erase(make_key(key));
+            key = rng();
+            map.insert(make_value(key));
+        }
+    }
+    std::chrono::duration<double, std::nano> time = Clock::now() - start;
+    return time.count() / (2 * size + 2 * ops);
+}
+
+template <size_t N>
+struct MakePair {
+    std::pair<uint64_t, Elem<N> > operator()(uint64_t key) const {
+        return std::make_pair(key, Elem<N>(key));
+    }
+};
+
+struct SameKey {
+    uint64_t operator()(uint64_t key) const { return key; }
+};
+
+// у set ключ - сам элемент
+template <size_t N>
+struct MakeElem {
+    Elem<N> operator()(uint64_t key) const { return Elem<N>(key); }
+};
+
+template <size_t N, template <typename> class Alloc>
+double run_container(const std::string &container, size_t size, size_t ops) {
+    typedef Elem<N> E;
+    typedef std::pair<const uint64_t, E> P;
+    uint64_t seed = size * 31 + N;
+
+    if (container == "List") {
+        return run_sequence<List<E, Alloc<E> >, N>(size, ops);
+    } else if (container == "std::list") {
+        return run_sequence<std::list<E, Alloc<E> >, N>(size, ops);
+    } else if (container == "std::map") {
+        return run_keyed<
+            std::map<uint64_t, E, std::less<uint64_t>, Alloc<P> > >(
+            size, ops, seed, MakePair<N>(), SameKey());
+    } else if (container == "std::set") {
+        return run_keyed<std::set<E, std::less<E>, Alloc<E> > >(
+            size, ops, seed, MakeElem<N>(), MakeElem<N>());
+    } else {
+        return run_keyed<std::unordered_map<uint64_t, E, std::hash<uint64_t>,
+                                            std::equal_to<uint64_t>,
+                                            Alloc<P> > >(
+            size, ops, seed, MakePair<N>(), SameKey());
+    }
+}
+
+template <template <typename> class Alloc>
+double run_allocator(const std::string &container, size_t elem, size_t size,
+                     size_t ops) {
+    switch (elem) {
+        case 1: return run_container<1, Alloc>(container, size, ops);
+        case 8: return run_container<8, Alloc>(container, size, ops);
+        case 64: return run_container<64, Alloc>(container, size, ops);
+        case 256: return run_container<256, Alloc>(container, size, ops);
+        default: return run_container<1024, Alloc>(container, size, ops);
+    }
+}
+
+struct Scenario {
+    std::string container;
+    std::string allocator;
+    size_t elem;
+    size_t size;
+    size_t ops;
+    double ns_per_op;
+};
+
+static std::string key_of(const Scenario &s) {
+    return s.container + "/" + s.allocator + "/" + std::to_string(s.elem) +
+           "/" + std::to_string(s.size);
+}
+
+/*
+ *  Лучший из reps прогонов в дочернем процессе; отрицательное - прогон
+ * упал (например, не хватило памяти)
+ */
+static double measure(const Scenario &s, size_t reps) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        std::exit(2);
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(2);
+    }
+
+    if (child == 0) {
+        close(fds[0]);
+        double best = 0;
+        for (size_t rep = 0; rep < reps; rep++) {
+            double time =
+                s.allocator == "fast"
+                    ? run_allocator<FastAllocator>(s.container, s.elem, s.size,
+                                                   s.ops)
+                    : run_allocator<std::allocator>(s.container, s.elem,
+                                                    s.size, s.ops);
+            if (rep == 0 || time < best) {
+                best = time;
+            }
+        }
+        ssize_t written = write(fds[1], &best, sizeof(best));
+        _exit(written == static_cast<ssize_t>(sizeof(best)) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    double best = -1;
+    ssize_t got = read(fds[0], &best, sizeof(best));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (got != static_cast<ssize_t>(sizeof(best)) || status != 0) {
+        return -1;
+    }
+    return best;
+}
+
+static void write_json(FILE *out, const std::vector<Scenario> &results) {
+    std::fprintf(out, "{\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Scenario &s = results[i];
+        std::fprintf(out,
+                     "    {\"container\": \"%s\", \"allocator\": \"%s\", "
+                     "\"elem_size\": %zu, \"size\": %zu, \"ops\": %zu, "
+                     "\"ns_per_op\": %.3f}%s\n",
+                     s.container.c_str(), s.allocator.c_str(), s.elem, s.size,
+                     s.ops, s.ns_per_op, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+/*
+ *  Разбираем только то, что пишет write_json: запись на строку
+ */
+static bool json_field(const std::string &line, const char *name,
+                       std::string &value) {
+    std::string pattern = std::string("\"") + name + "\": ";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += pattern.size();
+
+    if (line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        value = line.substr(pos + 1, end - pos - 1);
+    } else {
+        size_t end = line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+    }
+    return true;
+}
+
+static std::vector<Scenario> read_json(const char *path) {
+    std::vector<Scenario> results;
+    FILE *in = std::fopen(path, "r");
+    if (in == nullptr) {
+        std::perror(path);
+        std::exit(2);
+    }
+
+    char buffer[1024];
+    while (std::fgets(buffer, sizeof(buffer), in)) {
+        std::string line(buffer);
+        Scenario s;
+        std::string elem, size, ops, time;
+        if (json_field(line, "container", s.container) &&
+            json_field(line, "allocator", s.allocator) &&
+            json_field(line, "elem_size", elem) &&
+            json_field(line, "size", size) && json_field(line, "ops", ops) &&
+            json_field(line, "ns_per_op", time)) {
+            s.elem = std::strtoul(elem.c_str(), nullptr, 10);
+            s.size = std::strtoul(size.c_str(), nullptr, 10);
+            s.ops = std::strtoul(ops.c_str(), nullptr, 10);
+            s.ns_per_op = std::strtod(time.c_str(), nullptr);
+            results.push_back(s);
+        }
+    }
+    std::fclose(in);
+    return results;
+}
+
+static std::vector<size_t> parse_list(const char *text) {
+    std::vector<size_t> values;
+    const char *p = text;
+    while (*p) {
+        char *end;
+        size_t value = std::strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        values.push_back(value);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+/*
+ *  Накладные расходы узла в байтах - только чтобы не запускать
+ * сценарии, которые заведомо не влезут в --max-bytes
+ */
+static size_t node_overhead(const std::string &container) {
+    return container == "std::unordered_map" ? 40 : 48;
+}
+
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes = {10, 1000, 100000, 1000000};
+    std::vector<size_t> elems = {1, 8, 64, 256, 1024};
+    size_t reps = 3;
+    size_t max_bytes = size_t(256) << 20;
+    double threshold = 10;
+    const char *out_path = nullptr;
+    const char *baseline_path = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sizes") {
+            sizes = parse_list(argv[i + 1]);
+        } else if (flag == "--elems") {
+            elems = parse_list(argv[i + 1]);
+        } else if (flag == "--reps") {
+            reps = std::max<size_t>(1, std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (flag == "--max-bytes") {
+            max_bytes = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (flag == "--out") {
+            out_path = argv[i + 1];
+        } else if (flag == "--baseline") {
+            baseline_path = argv[i + 1];
+        } else if (flag == "--threshold") {
+            threshold = std::strtod(argv[i + 1], nullptr);
+        } else {
+            std::fprintf(stderr, "unknown flag %s\n", flag.c_str());
+            return 2;
+        }
+    }
+
+    const char *containers[] = {"List", "std::list", "std::map", "std::set",
+                                "std::unordered_map"};
+    const char *allocators[] = {"std", "fast"};
+
+    std::vector<Scenario> results;
+    std::fprintf(stderr, "%-20s %6s %9s %10s %10s %8s\n", "container", "elem",
+                 "size", "std_ns", "fast_ns", "speedup");
+    for (const char *container : containers) {
+        for (size_t elem : elems) {
+            // у set ключ - первые байты элемента, в одном байте мало ключей
+            if (std::string(container) == "std::set" && elem < 8) {
+                continue;
+            }
+            for (size_t size : sizes) {
+                if (size == 0 ||
+                    size * (elem + node_overhead(container)) > max_bytes) {
+                    continue;
+                }
+
+                double times[2] = {-1, -1};
+                for (size_t a = 0; a < 2; a++) {
+                    Scenario s{container, allocators[a], elem, size,
+                               std::max<size_t>(2 * size, 200000), 0};
+                    s.ns_per_op = measure(s, reps);
+                    times[a] = s.ns_per_op;
+                    results.push_back(s);
+                }
+
+                if (times[0] < 0 || times[1] < 0) {
+                    std::fprintf(stderr,
+                                 "%-20s %6zu %9zu %10.2f %10.2f   failed\n",
+                                 container, elem, size, times[0], times[1]);
+                    continue;
+                }
+
+                // List и std::list на стандартном - это планка из README
+                bool sequence = std::string(container) == "List" ||
+                                std::string(container) == "std::list";
+                double speedup = times[0] / times[1];
+                std::fprintf(stderr, "%-20s %6zu %9zu %10.2f %10.2f %7.2fx%s\n",
+                             container, elem, size, times[0], times[1],
+                             speedup,
+                             sequence && speedup < 1.1 ? "  below README bar"
+                                                       : "");
+            }
+        }
+    }
+
+    FILE *out = out_path ? std::fopen(out_path, "w") : stdout;
+    if (out == nullptr) {
+        std::perror(out_path);
+        return 2;
+    }
+    write_json(out, results);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    if (baseline_path == nullptr) {
+        return 0;
+    }
+
+    std::map<std::string, double> current;
+    for (const Scenario &s : results) {
+        current[key_of(s)] = s.ns_per_op;
+    }
+
+    size_t regressions = 0;
+    for (const Scenario &s : results) {
+        if (s.ns_per_op < 0) {
+            std::fprintf(stderr, "FAILED %s\n", key_of(s).c_str());
+            ++regressions;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    for (const Scenario &s : read_json(baseline_path)) {
+        baseline[key_of(s)] = s.ns_per_op;
+        if (current.count(key_of(s)) == 0) {
+            std::fprintf(stderr, "MISSING %s: not run this time\n",
+                         key_of(s).c_str());
+            ++regressions;
+        }
+    }
+
+    for (const Scenario &s : results) {
+        auto it = baseline.find(key_of(s));
+        if (s.ns_per_op < 0 || it == baseline.end() || it->second <= 0) {
+            continue;
+        }
+        double change = (s.ns_per_op / it->second - 1) * 100;
+        if (change > threshold) {
+            std::fprintf(stderr,
+                         "REGRESSION %s: %.2f -> %.2f ns/op (+%.1f%%)\n",
+                         key_of(s).c_str(), it->second, s.ns_per_op, change);
+            ++regressions;
+        }
+    }
+
+    std::fprintf(stderr, "%zu regression(s) over %.1f%% against %s\n",
+                 regressions, threshold, baseline_path);
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include "../fastallocator.h"
+#include "../flatcombining.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ *      FlatCombiningList против List под мьютексом
+ *
+ *      Каждый поток делает ops пар push_back + pop_front над одним общим
+ * листом. Печатаем миллионы операций в секунду для 1, 2, 4, ... 64
+ * потоков
+ *
+ *      ./flatcombining [ops] [max_threads]
+ *
+ */
+
+struct MutexList {
+    void push_back(int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        list_.push_back(value);
+    }
+
+    bool try_pop_front(int &out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (list_.size() == 0) {
+            return false;
+        }
+        out = *list_.begin();
+        list_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    List<int, FastAllocator<int> > list_;
+};
+
+template <typename Shared>
+double run(size_t threads, size_t ops) {
+    Shared list;
+    std::atomic<long long> sum{0};
+
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&list, &sum, ops] {
+            long long local = 0;
+            int value;
+            for (size_t i = 0; i < ops; i++) {
+                list.push_back(static_cast<int>(i));
+                if (list.try_pop_front(value)) {
+                    local += value;
+                }
+            }
+            sum.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+
+    return 2.0 * threads * ops / time.count() / 1e6;
+}
+
+int main(int argc, char **argv) {
+    size_t ops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t max_threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+
+    std::printf("threads  combining_mops  mutex_list_mops\n");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double combining =
+            run<FlatCombiningList<int, FastAllocator<int> > >(threads, ops);
+        double locked = run<MutexList>(threads, ops);
+        std::printf("%7zu  %14.2f  %15.2f\n", threads, combining, locked);
+    }
+    return 0;
+}
@@ -0,0 +1,340 @@
+#include "../fastallocator.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *
+ *      Как порядок выделения узлов влияет на обход List
+ *
+ *      Лист строится тремя способами:
+ *      - sequential  - просто push_back, узлы в памяти идут в порядке
+ *                      листа
+ *      - random      - каждый новый узел вставляется перед случайным
+ *                      уже существующим, соседи по листу оказываются
+ *                      где угодно в памяти
+ *      - churn       - sequential, а потом 2 * elements раз удаляем
+ *                      случайный узел и вставляем новый в случайное
+ *                      место. Так выглядит лист после долгой работы:
+ *                      освобожденные блоки переиспользуются вперемешку
+ *
+ *      Для каждого листа меряем три фазы: обход (reps раз), sort и обход
+ * уже отсортированного листа. Значения случайные, так что sort
+ * перевешивает узлы и портит порядок даже у sequential
+ *
+ *      Кроме времени читаем счетчики процессора через perf_event_open:
+ * промахи кэша, промахи dTLB, инструкции и такты (из них IPC). В
+ * контейнерах и при perf_event_paranoid > 2 счетчики обычно недоступны -
+ * тогда в этих колонках пусто, время все равно печатается
+ *
+ *      Каждый прогон - в отдельном процессе, чтобы пулы FastAllocator
+ * были чистыми
+ *
+ *      ./locality [elements] [reps]
+ *
+ *      Вывод - CSV
+ *
+ */
+
+/*
+ *  Один аппаратный счетчик. Если открыть не вышло, fd_ == -1 и value()
+ * возвращает -1
+ */
+struct PerfCounter {
+private:
+    int fd_ = -1;
+
+public:
+    PerfCounter(uint32_t type, uint64_t config);
+    ~PerfCounter();
+
+    PerfCounter(const PerfCounter &) = delete;
+    PerfCounter &operator=(const PerfCounter &) = delete;
+
+    bool available() const { return fd_ != -1; }
+
+    void start();
+    void stop();
+    double value() const;
+};
+
+PerfCounter::PerfCounter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd_ < 0) {
+        fd_ = -1;
+    }
+}
+
+PerfCounter::~PerfCounter() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+void PerfCounter::start() {
+    if (fd_ != -1) {
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounter::stop() {
+    if (fd_ != -1) {
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+/*
+ *  Счетчиков в процессоре мало, ядро может их мультиплексировать -
+ * тогда досчитываем пропорционально времени, когда счетчик реально шел
+ */
+double PerfCounter::value() const {
+    if (fd_ == -1) {
+        return -1;
+    }
+    uint64_t data[3];
+    if (read(fd_, data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+        return -1;
+    }
+    return double(data[0]) * double(data[1]) / double(data[2]);
+}
+
+static uint64_t hw_cache(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+struct Counters {
+    PerfCounter cycles{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    PerfCounter instructions{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+    PerfCounter cache_misses{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    PerfCounter dtlb_misses{
+        PERF_TYPE_HW_CACHE,
+        hw_cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                 PERF_COUNT_HW_CACHE_RESULT_MISS)};
+
+    bool any() const {
+        return cycles.available() || instructions.available() ||
+               cache_misses.available() || dtlb_misses.available();
+    }
+
+    void start() {
+        cycles.start();
+        instructions.start();
+        cache_misses.start();
+        dtlb_misses.start();
+    }
+
+    void stop() {
+        dtlb_misses.stop();
+        cache_misses.stop();
+        instructions.stop();
+        cycles.stop();
+    }
+};
+
+struct XorShift {
+    uint64_t state;
+
+    explicit XorShift(uint64_t seed) : state(seed) {}
+
+    uint64_t operator()() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+template <typename Alloc>
+using Iterators = std::vector<typename List<uint64_t, Alloc>::iterator>;
+
+template <typename Alloc>
+static void build_sequential(List<uint64_t, Alloc> &list, size_t elements,
+                             XorShift &rng) {
+    for (size_t i = 0; i < elements; i++) {
+        list.push_back(rng());
+    }
+}
+
+/*
+ *  Случайную позицию берем из массива итераторов, иначе каждая вставка
+ * стоила бы O(n)
+ */
+template <typename Alloc>
+static void build_random(List<uint64_t, Alloc> &list, size_t elements,
+                         XorShift &rng) {
+    Iterators<Alloc> nodes;
+    nodes.reserve(elements);
+    for (size_t i = 0; i < elements; i++) {
+        auto where = nodes.empty() ? list.end() : nodes[rng() % nodes.size()];
+        nodes.push_back(list.insert(where, rng()));
+    }
+}
+
+template <typename Alloc>
+static void build_churn(List<uint64_t, Alloc> &list, size_t elements,
+                        XorShift &rng) {
+    Iterators<Alloc> nodes;
+    nodes.reserve(elements);
+    for (size_t i = 0; i < elements; i++) {
+        list.push_back(rng());
+        nodes.push_back(--list.end());
+    }
+    for (size_t i = 0; i < 2 * elements && elements > 1; i++) {
+        size_t victim = rng() % nodes.size();
+        list.erase(nodes[victim]);
+        nodes[victim] = nodes.back();
+        nodes.pop_back();
+        auto where = nodes[rng() % nodes.size()];
+        nodes.push_back(list.insert(where, rng()));
+    }
+}
+
+static volatile uint64_t sink;
+
+static void print_row(const char *allocator, const char *history,
+                      size_t elements, const char *phase, double seconds,
+                      size_t touched, const Counters &counters) {
+    double per = double(touched);
+    std::printf("%s,%s,%zu,%s,%.2f", allocator, history, elements, phase,
+                seconds * 1e9 / per);
+
+    double misses = counters.cache_misses.value();
+    double dtlb = counters.dtlb_misses.value();
+    double cycles = counters.cycles.value();
+    double instructions = counters.instructions.value();
+    if (misses >= 0) {
+        std::printf(",%.4f", misses / per);
+    } else {
+        std::printf(",");
+    }
+    if (dtlb >= 0) {
+        std::printf(",%.4f", dtlb / per);
+    } else {
+        std::printf(",");
+    }
+    if (cycles > 0 && instructions >= 0) {
+        std::printf(",%.3f\n", instructions / cycles);
+    } else {
+        std::printf(",\n");
+    }
+}
+
+template <typename Alloc>
+static void traverse(const List<uint64_t, Alloc> &list, const char *allocator,
+                     const char *history, const char *phase, size_t reps) {
+    Counters counters;
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    counters.start();
+    for (size_t rep = 0; rep < reps; rep++) {
+        for (uint64_t value : list) {
+            sum += value;
+        }
+    }
+    counters.stop();
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    sink = sum;
+    print_row(allocator, history, list.size(), phase, time.count(),
+              list.size() * reps, counters);
+}
+
+template <typename Alloc>
+static void sort(List<uint64_t, Alloc> &list, const char *allocator,
+                 const char *history) {
+    Counters counters;
+    auto start = std::chrono::steady_clock::now();
+    counters.start();
+    list.sort();
+    counters.stop();
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    print_row(allocator, history, list.size(), "sort", time.count(),
+              list.size(), counters);
+}
+
+template <typename Alloc>
+static void measure(const char *allocator, const std::string &history,
+                    size_t elements, size_t reps) {
+    XorShift rng(42);
+    List<uint64_t, Alloc> list;
+    if (history == "sequential") {
+        build_sequential(list, elements, rng);
+    } else if (history == "random") {
+        build_random(list, elements, rng);
+    } else {
+        build_churn(list, elements, rng);
+    }
+
+    traverse(list, allocator, history.c_str(), "traverse", reps);
+    sort(list, allocator, history.c_str());
+    traverse(list, allocator, history.c_str(), "traverse_sorted", reps);
+}
+
+static void run(const char *allocator, const char *history, size_t elements,
+                size_t reps) {
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(1);
+    }
+    if (child == 0) {
+        if (std::string(allocator) == "fast") {
+            measure<FastAllocator<uint64_t> >(allocator, history, elements,
+                                              reps);
+        } else {
+            measure<std::allocator<uint64_t> >(allocator, history, elements,
+                                               reps);
+        }
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+}
+
+int main(int argc, char **argv) {
+    size_t elements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t reps = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+
+    if (!Counters().any()) {
+        std::fprintf(stderr, "perf_event_open недоступен, печатаем только "
+                             "время\n");
+    }
+
+    const char *histories[] = {"sequential", "random", "churn"};
+    const char *allocators[] = {"fast", "std"};
+
+    std::printf("allocator,history,elements,phase,ns_per_elem,"
+                "cache_misses_per_elem,dtlb_misses_per_elem,ipc\n");
+    for (const char *history : histories) {
+        for (const char *allocator : allocators) {
+            run(allocator, history, elements, reps);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "../fastallocator.h"
+#include "../lockfreeset.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ *      LockFreeSet против List под мьютексом
+ *
+ *      Каждый поток делает ops операций над ключами из [0, keys):
+ * 80% contains, 10% insert, 10% erase. Печатаем суммарную пропускную
+ * способность в миллионах операций в секунду для 1, 2, 4, ... потоков
+ *
+ *      ./lockfreeset [ops] [keys] [max_threads]
+ *
+ */
+
+/*
+ *  Упорядоченный List под одним мьютексом - то, что было до LockFreeSet
+ */
+struct MutexListSet {
+    bool insert(int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = list_.begin();
+        while (it != list_.end() && *it < value) {
+            ++it;
+        }
+        if (it != list_.end() && *it == value) {
+            return false;
+        }
+        list_.insert(it, value);
+        return true;
+    }
+
+    bool erase(int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = list_.begin();
+        while (it != list_.end() && *it < value) {
+            ++it;
+        }
+        if (it == list_.end() || *it != value) {
+            return false;
+        }
+        list_.erase(it);
+        return true;
+    }
+
+    bool contains(int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = list_.begin();
+        while (it != list_.end() && *it < value) {
+            ++it;
+        }
+        return it != list_.end() && *it == value;
+    }
+
+private:
+    std::mutex mutex_;
+    List<int, FastAllocator<int> > list_;
+};
+
+template <typename Set>
+double run(size_t threads, size_t ops, int keys) {
+    Set set;
+    for (int i = 0; i < keys; i += 2) {
+        set.insert(i);
+    }
+
+    // результаты копим, иначе компилятор выкинет contains целиком
+    std::atomic<size_t> hits{0};
+
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&set, &hits, t, ops, keys] {
+            std::mt19937 random(static_cast<unsigned>(t + 1));
+            size_t local = 0;
+            for (size_t i = 0; i < ops; i++) {
+                int key = static_cast<int>(random() % keys);
+                unsigned op = random() % 10;
+                if (op == 0) {
+                    local += set.insert(key);
+                } else if (op == 1) {
+                    local += set.erase(key);
+                } else {
+                    local += set.contains(key);
+                }
+            }
+            hits.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+
+    return threads * ops / time.count() / 1e6;
+}
+
+int main(int argc, char **argv) {
+    size_t ops = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    int keys = argc > 2 ? std::atoi(argv[2]) : 1024;
+    size_t max_threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10)
+                                  : 2 * std::thread::hardware_concurrency();
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+
+    std::printf("threads  lockfree_mops  mutex_list_mops\n");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double lockfree = run<LockFreeSet<int> >(threads, ops, keys);
+        double locked = run<MutexListSet>(threads, ops, keys);
+        std::printf("%7zu  %13.2f  %15.2f\n", threads, lockfree, locked);
+    }
+    return 0;
+}
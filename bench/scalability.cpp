@@ -0,0 +1,433 @@
+#include "../concurrentallocator.h"
+#include "../fastallocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *
+ *      Как аллокаторы масштабируются по потокам
+ *
+ *      Три аллокатора:
+ *      - fast_mutex  - FastAllocator, каждый вызов под одним общим
+ *                      мьютексом (сам по себе он однопоточный)
+ *      - concurrent  - ConcurrentFastAllocator: кэш на поток
+ *      - std         - std::allocator
+ *
+ *      Три нагрузки:
+ *      - churn     - у каждого потока свой List, push_back/pop_front
+ *      - handoff   - потоки парами: один выделяет, другой освобождает,
+ *                    указатели идут через кольцевой буфер. Отдельно
+ *                    меряется цена освобождения чужого блока
+ *      - shared    - один List на всех под мьютексом
+ *
+ *      Для concurrent еще печатаем, сколько памяти осталось в кэше потока
+ * к концу его работы (в среднем на поток)
+ *
+ *      Каждый прогон - в отдельном процессе. С --pin поток i
+ * привязывается к ядру i % (число ядер), так цифры стабильнее
+ *
+ *      ./scalability [ops_per_thread] [max_threads] [--pin]
+ *
+ *      Вывод - CSV
+ *
+ */
+
+// List<int>: int и два указателя
+static const size_t node_bytes = 24;
+
+struct Payload {
+    char data[node_bytes];
+};
+
+static std::mutex &fast_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+template <typename T>
+struct LockedFastAllocator {
+    using value_type = T;
+
+    LockedFastAllocator() = default;
+    template <typename U>
+    LockedFastAllocator(const LockedFastAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        std::lock_guard<std::mutex> lock(fast_mutex());
+        return FastAllocator<T>().allocate(n);
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        std::lock_guard<std::mutex> lock(fast_mutex());
+        FastAllocator<T>().deallocate(ptr, n);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const LockedFastAllocator<T> &,
+                const LockedFastAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const LockedFastAllocator<T> &,
+                const LockedFastAllocator<U> &) {
+    return false;
+}
+
+static bool pin_threads = false;
+
+static void pin(size_t index) {
+#ifdef __linux__
+    if (!pin_threads) {
+        return;
+    }
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)index;
+#endif
+}
+
+/*
+ *  Сколько байт лежит в кэше текущего потока (только для concurrent)
+ */
+template <template <typename> class Alloc>
+struct CacheBytes {
+    static size_t current() { return 0; }
+};
+
+template <>
+struct CacheBytes<ConcurrentFastAllocator> {
+    static size_t current() {
+        ConcurrentFixedAllocator<node_bytes> *allocator =
+            ConcurrentFixedAllocator<node_bytes>::getConcurrentFixedAllocator();
+        return allocator->cached() * node_bytes;
+    }
+};
+
+struct Result {
+    double seconds;
+    double cross_free_ns;
+    double cache_bytes_per_thread;
+};
+
+/*
+ *  Все потоки стартуют по общему сигналу, время - от сигнала до
+ * последнего join
+ */
+struct StartLine {
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+
+    void wait() {
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::chrono::steady_clock::time_point release(size_t threads) {
+        while (ready.load() < threads) {
+            std::this_thread::yield();
+        }
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        return start;
+    }
+};
+
+template <template <typename> class Alloc>
+Result run_churn(size_t threads, size_t ops) {
+    StartLine line;
+    std::atomic<size_t> cache_bytes{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&line, &cache_bytes, t, ops] {
+            pin(t);
+            List<int, Alloc<int> > list;
+            uint64_t state = t * 0x9e3779b97f4a7c15 + 1;
+            line.wait();
+            for (size_t i = 0; i < ops; i++) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                if (list.size() < 64 || (list.size() < 4096 && (state & 1))) {
+                    list.push_back(static_cast<int>(i));
+                } else {
+                    list.pop_front();
+                }
+            }
+            cache_bytes.fetch_add(CacheBytes<Alloc>::current());
+        });
+    }
+
+    auto start = line.release(threads);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    return Result{time.count(), 0, double(cache_bytes.load()) / threads};
+}
+
+/*
+ *  Кольцо на одного писателя и одного читателя
+ */
+struct Ring {
+    static const size_t capacity = 1024;
+
+    // голова и хвост в разных строках кэша (alignas у типа, который
+    // лежит в vector, в C++14 не гарантируется)
+    std::atomic<size_t> head{0};
+    char head_pad[64];
+    std::atomic<size_t> tail{0};
+    char tail_pad[64];
+    Payload *slots[capacity];
+
+    bool push(Payload *value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == capacity) {
+            return false;
+        }
+        slots[t % capacity] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Payload *&value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[h % capacity];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/*
+ *  threads округляется вверх до четного. Потребитель копит до 64 блоков
+ * и освобождает их подряд под таймером - это и есть цена освобождения
+ * блока, выделенного в другом потоке
+ */
+template <template <typename> class Alloc>
+Result run_handoff(size_t threads, size_t ops) {
+    size_t pairs = std::max<size_t>(1, (threads + 1) / 2);
+    StartLine line;
+    std::vector<Ring> rings(pairs);
+    std::atomic<uint64_t> free_ns{0};
+    std::atomic<size_t> cache_bytes{0};
+
+    std::vector<std::thread> workers;
+    for (size_t p = 0; p < pairs; p++) {
+        Ring &ring = rings[p];
+        workers.emplace_back([&line, &ring, p, ops] {
+            pin(2 * p);
+            Alloc<Payload> alloc;
+            line.wait();
+            for (size_t i = 0; i < ops; i++) {
+                Payload *block = alloc.allocate(1);
+                block->data[0] = static_cast<char>(i);
+                while (!ring.push(block)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        workers.emplace_back([&line, &ring, &free_ns, &cache_bytes, p, ops] {
+            pin(2 * p + 1);
+            Alloc<Payload> alloc;
+            Payload *batch[64];
+            uint64_t spent = 0;
+            line.wait();
+            for (size_t done = 0; done < ops;) {
+                size_t count = 0;
+                while (count < 64 && done + count < ops &&
+                       ring.pop(batch[count])) {
+                    ++count;
+                }
+                if (count == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < count; i++) {
+                    alloc.deallocate(batch[i], 1);
+                }
+                spent += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+                done += count;
+            }
+            free_ns.fetch_add(spent);
+            cache_bytes.fetch_add(CacheBytes<Alloc>::current());
+        });
+    }
+
+    auto start = line.release(2 * pairs);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    return Result{time.count(), double(free_ns.load()) / (pairs * ops),
+                  double(cache_bytes.load()) / (2 * pairs)};
+}
+
+template <template <typename> class Alloc>
+Result run_shared(size_t threads, size_t ops) {
+    StartLine line;
+    std::mutex mutex;
+    List<int, Alloc<int> > list;
+    std::atomic<size_t> cache_bytes{0};
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&line, &mutex, &list, &cache_bytes, t, ops] {
+            pin(t);
+            line.wait();
+            for (size_t i = 0; i < ops; i++) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (i % 2 == 0 || list.size() == 0) {
+                    list.push_back(static_cast<int>(i));
+                } else {
+                    list.pop_front();
+                }
+            }
+            cache_bytes.fetch_add(CacheBytes<Alloc>::current());
+        });
+    }
+
+    auto start = line.release(threads);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    return Result{time.count(), 0, double(cache_bytes.load()) / threads};
+}
+
+template <template <typename> class Alloc>
+Result run_workload(const std::string &workload, size_t threads, size_t ops) {
+    if (workload == "churn") {
+        return run_churn<Alloc>(threads, ops);
+    } else if (workload == "handoff") {
+        return run_handoff<Alloc>(threads, ops);
+    } else {
+        return run_shared<Alloc>(threads, ops);
+    }
+}
+
+static void run(const std::string &workload, const std::string &allocator,
+                size_t threads, size_t ops) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(1);
+    }
+
+    if (child == 0) {
+        close(fds[0]);
+        Result result;
+        if (allocator == "fast_mutex") {
+            result = run_workload<LockedFastAllocator>(workload, threads, ops);
+        } else if (allocator == "concurrent") {
+            result =
+                run_workload<ConcurrentFastAllocator>(workload, threads, ops);
+        } else {
+            result = run_workload<std::allocator>(workload, threads, ops);
+        }
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    Result result;
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (got != static_cast<ssize_t>(sizeof(result)) || status != 0) {
+        std::fprintf(stderr, "%s/%s/%zu failed\n", workload.c_str(),
+                     allocator.c_str(), threads);
+        return;
+    }
+
+    // в handoff потоков всегда четное число, операция - блок от
+    // выделения до освобождения
+    bool handoff = workload == "handoff";
+    size_t actual =
+        handoff ? std::max<size_t>(2, threads + threads % 2) : threads;
+    double total_ops = double(ops) * (handoff ? actual / 2 : actual);
+    double mops = total_ops / result.seconds / 1e6;
+
+    std::printf("%s,%s,%zu,%.3f,%.3f,", workload.c_str(), allocator.c_str(),
+                actual, mops, mops / actual);
+    if (handoff) {
+        std::printf("%.2f,", result.cross_free_ns);
+    } else {
+        std::printf(",");
+    }
+    std::printf("%.0f\n", result.cache_bytes_per_thread);
+    std::fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--pin") == 0) {
+            pin_threads = true;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    size_t ops = positional.size() > 0
+                     ? std::strtoul(positional[0].c_str(), nullptr, 10)
+                     : 1000000;
+    size_t max_threads =
+        positional.size() > 1
+            ? std::strtoul(positional[1].c_str(), nullptr, 10)
+            : std::max(4u, 2 * std::thread::hardware_concurrency());
+
+    const char *workloads[] = {"churn", "handoff", "shared"};
+    const char *allocators[] = {"fast_mutex", "concurrent", "std"};
+
+    std::printf("workload,allocator,threads,mops,mops_per_thread,"
+                "cross_free_ns,cache_bytes_per_thread\n");
+    for (const char *workload : workloads) {
+        size_t first = std::string(workload) == "handoff" ? 2 : 1;
+        for (size_t threads = first; threads <= max_threads; threads *= 2) {
+            for (const char *allocator : allocators) {
+                run(workload, allocator, threads, ops);
+            }
+        }
+    }
+    return 0;
+}
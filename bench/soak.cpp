@@ -0,0 +1,459 @@
+#include "../fastallocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *
+ *      Долгий прогон: что происходит с памятью
+ *
+ *      FixedAllocator ничего не возвращает системе, а узлы после долгой
+ * работы разбросаны по кускам. Здесь это видно по времени: один и тот же
+ * сценарий гоняется с FastAllocator и с std::allocator, и каждые
+ * несколько тысяч операций снимается RSS и заполненность пулов
+ *
+ *      Один цикл - это фазы:
+ *      - grow    - List<16 байт> и std::map<uint64, 16 байт> растут до
+ *                  elements
+ *      - churn   - случайные удаления и вставки при том же размере
+ *      - shrink  - удаляем 90%
+ *      - shift   - размеры меняются: List<96 байт> и
+ *                  std::unordered_map<uint64, 96 байт> растут до elements,
+ *                  потом churn уже на них
+ *      - drain   - все очищаем
+ *      Циклов - cycles, чтобы было видно, возвращается ли память
+ *
+ *      Потом - статический размер на элемент: контейнер из миллиона
+ * элементов в чистом процессе, прирост RSS и сколько байт контейнер
+ * попросил у аллокатора
+ *
+ *      Вывод - CSV, строки двух видов: "series,..." (временной ряд) и
+ * "footprint,...", у каждого вида свой заголовок
+ *
+ *      ./soak [elements] [ops_per_phase] [cycles]
+ *
+ */
+
+template <size_t N>
+struct Elem {
+    unsigned char data[N];
+
+    Elem() { std::memset(data, 0, N); }
+    explicit Elem(uint64_t key) {
+        std::memset(data, 0, N);
+        std::memcpy(data, &key, sizeof(key) < N ? sizeof(key) : N);
+    }
+};
+
+static long current_rss_kb() {
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return -1;
+    }
+    long pages = 0;
+    long resident = 0;
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    std::fclose(statm);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*
+ *  Пулы, которыми пользовались контейнеры: размер блока -> сколько байт
+ * взято у системы и сколько занято
+ */
+struct PoolStats {
+    size_t reserved;
+    size_t used;
+};
+
+static std::map<size_t, PoolStats (*)()> &pools() {
+    static std::map<size_t, PoolStats (*)()> registry;
+    return registry;
+}
+
+template <size_t N>
+PoolStats pool_stats() {
+    FixedAllocator<N> *pool = FixedAllocator<N>::getFixedAllocator();
+    return PoolStats{pool->reserved_blocks() * N,
+                     (pool->reserved_blocks() - pool->free_blocks()) * N};
+}
+
+template <template <typename> class Base>
+struct Pools {
+    template <size_t N>
+    static void note() {}
+};
+
+template <>
+struct Pools<FastAllocator> {
+    // крупнее maxSize у FastAllocator в пулы не попадает
+    template <size_t N>
+    static void note() {
+        if (N <= 32) {
+            pools()[N] = &pool_stats<N>;
+        }
+    }
+};
+
+static PoolStats total_pools() {
+    PoolStats total{0, 0};
+    for (auto &pool : pools()) {
+        PoolStats stats = pool.second();
+        total.reserved += stats.reserved;
+        total.used += stats.used;
+    }
+    return total;
+}
+
+static size_t &requested_bytes() {
+    static size_t bytes = 0;
+    return bytes;
+}
+
+/*
+ *  Обертка: считает, сколько байт попросили, и запоминает, какие пулы
+ * FastAllocator задействованы. Сама память - из Base
+ */
+template <typename T, template <typename> class Base>
+struct Tracked {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        typedef Tracked<U, Base> other;
+    };
+
+    Tracked() = default;
+    template <typename U>
+    Tracked(const Tracked<U, Base> &) {}
+
+    T *allocate(size_t n) {
+        static bool noted = (Pools<Base>::template note<sizeof(T)>(), true);
+        (void)noted;
+        requested_bytes() += n * sizeof(T);
+        return Base<T>().allocate(n);
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        requested_bytes() -= n * sizeof(T);
+        Base<T>().deallocate(ptr, n);
+    }
+};
+
+template <typename T, typename U, template <typename> class Base>
+bool operator==(const Tracked<T, Base> &, const Tracked<U, Base> &) {
+    return true;
+}
+
+template <typename T, typename U, template <typename> class Base>
+bool operator!=(const Tracked<T, Base> &, const Tracked<U, Base> &) {
+    return false;
+}
+
+template <typename T>
+using TrackedFast = Tracked<T, FastAllocator>;
+
+template <typename T>
+using TrackedStd = Tracked<T, std::allocator>;
+
+struct XorShift {
+    uint64_t state;
+
+    explicit XorShift(uint64_t seed) : state(seed) {}
+
+    uint64_t operator()() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+/*
+ *  Лист, в котором удаляют и вставляют у бродячего курсора - так узлы
+ * перемешиваются по памяти
+ */
+template <typename T, template <typename> class Alloc>
+struct Churned {
+    List<T, Alloc<T> > list;
+    typename List<T, Alloc<T> >::iterator cursor;
+
+    Churned() : cursor(list.begin()) {}
+
+    void step_(uint64_t roll) {
+        for (uint64_t step = roll & 3; step > 0 && cursor != list.end();
+             step--) {
+            ++cursor;
+        }
+        if (cursor == list.end()) {
+            cursor = list.begin();
+        }
+    }
+
+    void insert(uint64_t roll) {
+        step_(roll);
+        cursor = list.insert(cursor, T(roll));
+    }
+
+    void erase(uint64_t roll) {
+        step_(roll);
+        if (cursor != list.end()) {
+            cursor = list.erase(cursor);
+        }
+    }
+
+    void clear() {
+        list.clear();
+        cursor = list.begin();
+    }
+};
+
+/*
+ *  Ассоциативный контейнер плюс массив живых ключей, чтобы удалять
+ * случайный
+ */
+template <typename Map>
+struct Keyed {
+    Map map;
+    std::vector<uint64_t> keys;
+
+    template <typename Value>
+    void insert(uint64_t key) {
+        if (map.emplace(key, Value(key)).second) {
+            keys.push_back(key);
+        }
+    }
+
+    void erase(uint64_t roll) {
+        if (keys.empty()) {
+            return;
+        }
+        size_t index = roll % keys.size();
+        map.erase(keys[index]);
+        keys[index] = keys.back();
+        keys.pop_back();
+    }
+
+    void clear() {
+        map.clear();
+        keys.clear();
+        keys.shrink_to_fit();
+    }
+};
+
+template <template <typename> class Alloc>
+struct Soak {
+    typedef Elem<16> Small;
+    typedef Elem<96> Large;
+
+    Churned<Small, Alloc> small_list;
+    Keyed<std::map<uint64_t, Small, std::less<uint64_t>,
+                   Alloc<std::pair<const uint64_t, Small> > > >
+        small_map;
+    Churned<Large, Alloc> large_list;
+    Keyed<std::unordered_map<uint64_t, Large, std::hash<uint64_t>,
+                             std::equal_to<uint64_t>,
+                             Alloc<std::pair<const uint64_t, Large> > > >
+        large_map;
+
+    const char *allocator;
+    size_t elements;
+    size_t ops_per_phase;
+    size_t sample_every;
+    size_t ops = 0;
+    XorShift rng{42};
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    size_t live() const {
+        return small_list.list.size() + small_map.map.size() +
+               large_list.list.size() + large_map.map.size();
+    }
+
+    void sample(const char *phase) {
+        std::chrono::duration<double> time =
+            std::chrono::steady_clock::now() - start;
+        PoolStats stats = total_pools();
+        std::printf("series,%s,%.3f,%zu,%s,%zu,%ld,%zu,%zu\n", allocator,
+                    time.count(), ops, phase, live(), current_rss_kb(),
+                    stats.reserved / 1024, stats.used / 1024);
+    }
+
+    void tick(const char *phase) {
+        if (++ops % sample_every == 0) {
+            sample(phase);
+        }
+    }
+
+    void grow_small() {
+        while (small_list.list.size() < elements) {
+            small_list.insert(rng());
+            small_map.template insert<Small>(rng());
+            tick("grow");
+        }
+    }
+
+    void churn_small() {
+        for (size_t i = 0; i < ops_per_phase; i++) {
+            uint64_t roll = rng();
+            small_list.erase(roll >> 8);
+            small_list.insert(roll);
+            small_map.erase(roll >> 16);
+            small_map.template insert<Small>(rng());
+            tick("churn");
+        }
+    }
+
+    void shrink_small() {
+        while (small_list.list.size() > elements / 10) {
+            uint64_t roll = rng();
+            small_list.erase(roll);
+            small_map.erase(roll >> 16);
+            tick("shrink");
+        }
+    }
+
+    void shift() {
+        while (large_list.list.size() < elements) {
+            large_list.insert(rng());
+            large_map.template insert<Large>(rng());
+            tick("shift");
+        }
+        for (size_t i = 0; i < ops_per_phase; i++) {
+            uint64_t roll = rng();
+            large_list.erase(roll >> 8);
+            large_list.insert(roll);
+            large_map.erase(roll >> 16);
+            large_map.template insert<Large>(rng());
+            tick("shift");
+        }
+    }
+
+    void drain() {
+        small_list.clear();
+        small_map.clear();
+        large_list.clear();
+        large_map.clear();
+        sample("drain");
+    }
+
+    void run(size_t cycles) {
+        sample("start");
+        for (size_t cycle = 0; cycle < cycles; cycle++) {
+            grow_small();
+            churn_small();
+            shrink_small();
+            shift();
+            drain();
+        }
+    }
+};
+
+template <typename F>
+static void in_child(F f) {
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(1);
+    }
+    if (child == 0) {
+        f();
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+}
+
+/*
+ *  Сколько памяти на элемент, если просто построить контейнер
+ */
+template <typename Container, typename Fill>
+static void footprint(const char *container, const char *allocator,
+                      size_t count, Fill fill) {
+    in_child([=] {
+        long before = current_rss_kb();
+        size_t requested = requested_bytes();
+        Container c;
+        for (size_t i = 0; i < count; i++) {
+            fill(c, i);
+        }
+        long after = current_rss_kb();
+        std::printf("footprint,%s,%s,%zu,%.1f,%.1f\n", container, allocator,
+                    count, (after - before) * 1024.0 / count,
+                    double(requested_bytes() - requested) / count);
+    });
+}
+
+template <template <typename> class Alloc>
+static void footprints(const char *allocator, size_t count) {
+    typedef Elem<8> E;
+    auto push = [](auto &c, size_t i) { c.push_back(E(i)); };
+    auto emplace = [](auto &c, size_t i) { c.emplace(i, E(i)); };
+
+    footprint<List<E, Alloc<E> > >("List<8B>", allocator, count, push);
+    footprint<std::list<E, Alloc<E> > >("std::list<8B>", allocator, count,
+                                         push);
+    footprint<std::map<uint64_t, E, std::less<uint64_t>,
+                       Alloc<std::pair<const uint64_t, E> > > >(
+        "std::map<u64,8B>", allocator, count, emplace);
+    footprint<std::set<uint64_t, std::less<uint64_t>, Alloc<uint64_t> > >(
+        "std::set<u64>", allocator, count,
+        [](std::set<uint64_t, std::less<uint64_t>, Alloc<uint64_t> > &c,
+           size_t i) { c.insert(i); });
+    footprint<std::unordered_map<uint64_t, E, std::hash<uint64_t>,
+                                 std::equal_to<uint64_t>,
+                                 Alloc<std::pair<const uint64_t, E> > > >(
+        "std::unordered_map<u64,8B>", allocator, count, emplace);
+}
+
+int main(int argc, char **argv) {
+    size_t elements = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t ops_per_phase =
+        argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+    size_t cycles = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 3;
+    size_t sample_every = std::max<size_t>(1, ops_per_phase / 50);
+
+    std::printf("series,allocator,t_sec,ops,phase,live_elems,rss_kb,"
+                "pool_reserved_kb,pool_used_kb\n");
+    in_child([=] {
+        Soak<TrackedFast> soak{};
+        soak.allocator = "fast";
+        soak.elements = elements;
+        soak.ops_per_phase = ops_per_phase;
+        soak.sample_every = sample_every;
+        soak.run(cycles);
+    });
+    in_child([=] {
+        Soak<TrackedStd> soak{};
+        soak.allocator = "std";
+        soak.elements = elements;
+        soak.ops_per_phase = ops_per_phase;
+        soak.sample_every = sample_every;
+        soak.run(cycles);
+    });
+
+    std::printf("footprint,container,allocator,elements,rss_bytes_per_elem,"
+                "requested_bytes_per_elem\n");
+    footprints<TrackedFast>("fast", 1000000);
+    footprints<TrackedStd>("std", 1000000);
+    return 0;
+}
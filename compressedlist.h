@@ -0,0 +1,646 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+ *
+ *      CompressedList<T, Allocator>
+ *
+ *      Список целых чисел, сжатый блоками. Блок - это 128 байт: ссылки на
+ * соседние блоки, первое и последнее значение, а дальше разности соседних
+ * значений в zigzag + varint (маленькая разность - один байт)
+ *
+ *      На длинных почти монотонных последовательностях (id, времена)
+ * выходит 1-2 байта на число вместо 24 байт узла List<uint64_t>
+ *
+ *      Добавлять в конец - O(1). Вставка и удаление в середине работают с
+ * целым блоком: блок распаковывается, меняется и запаковывается обратно
+ * (если не влез - делится поровну с соседним или новым блоком, так что
+ * блоки остаются заполненными хотя бы наполовину)
+ *
+ *      Итератор только читающий и только вперед: значение каждый раз
+ * вычисляется из предыдущего. Для быстрых проходов есть for_each, он
+ * распаковывает блок целиком, обрабатывая по 8 однобайтовых разностей за
+ * раз
+ *
+ *      Блоки выделяются через Allocator (с FastAllocator - из
+ * FixedAllocator<128>)
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct CompressedList {
+    static_assert(std::is_integral<T>::value,
+                  "CompressedList stores integral types only");
+
+private:
+    static const size_t payload_ = 88;
+
+    struct Block {
+        Block *next;
+        Block *prev;
+        uint64_t first;
+        uint64_t last;
+        uint16_t count;
+        uint16_t bytes;
+        unsigned char data[payload_];
+    };
+
+    // максимум элементов в блоке: первый плюс по байту на разность
+    static const size_t max_count_ = payload_ + 1;
+
+public:
+    class const_iterator;
+    typedef const_iterator iterator;
+
+    explicit CompressedList(const Allocator &alloc = Allocator());
+    CompressedList(const CompressedList &rhs);
+    CompressedList &operator=(const CompressedList &rhs);
+    ~CompressedList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    T front() const;
+    T back() const;
+
+    void push_back(T value);
+    void push_front(T value);
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    const_iterator insert(const_iterator, T);
+    const_iterator erase(const_iterator);
+
+    template <typename Function>
+    void for_each(Function f) const;
+
+    size_t block_count() const;
+    size_t memory_usage() const;
+
+    Allocator get_allocator() const;
+
+private:
+    using block_allocator_type_ =
+        typename PoolRebind<Allocator, Block>::type;
+    using block_allocator_traits_ = std::allocator_traits<block_allocator_type_>;
+
+    static uint64_t zigzag_(uint64_t delta);
+    static uint64_t unzigzag_(uint64_t value);
+    static size_t put_varint_(unsigned char *out, uint64_t value);
+    static size_t varint_length_(uint64_t value);
+    static size_t get_varint_(const unsigned char *in, uint64_t &value);
+
+    static size_t decode_(const Block *, uint64_t *out);
+
+    Block *new_block_after_(Block *);
+    void delete_block_(Block *);
+
+    bool append_to_(Block *, uint64_t, size_t limit = payload_);
+    void encode_(Block *, const uint64_t *values, size_t count,
+                 Block *spare = nullptr);
+    const_iterator iterator_at_(Block *, size_t index) const;
+
+    block_allocator_type_ block_allocator_;
+    Block *head_ = nullptr;
+    Block *tail_ = nullptr;
+    size_t size_ = 0;
+    size_t blocks_ = 0;
+};
+
+/*
+ *
+ *      const_iterator
+ *
+ */
+
+template <typename T, typename Allocator>
+class CompressedList<T, Allocator>::const_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = const T *;
+    using reference = T;
+
+    const_iterator() = default;
+
+    T operator*() const;
+
+    const_iterator &operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator &rhs) const;
+    bool operator!=(const const_iterator &rhs) const;
+    friend struct CompressedList<T, Allocator>;
+
+private:
+    const_iterator(Block *block, size_t index, size_t offset, uint64_t value);
+
+    Block *block_ = nullptr;
+    size_t index_ = 0;
+    size_t offset_ = 0;  // где в data начинается следующая разность
+    uint64_t value_ = 0;
+};
+
+template <typename T, typename Allocator>
+CompressedList<T, Allocator>::const_iterator::const_iterator(Block *block,
+                                                             size_t index,
+                                                             size_t offset,
+                                                             uint64_t value)
+        : block_(block), index_(index), offset_(offset), value_(value) {}
+
+template <typename T, typename Allocator>
+T CompressedList<T, Allocator>::const_iterator::operator*() const {
+    return static_cast<T>(value_);
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator &
+CompressedList<T, Allocator>::const_iterator::operator++() {
+    if (index_ + 1 >= block_->count) {
+        block_ = block_->next;
+        index_ = 0;
+        offset_ = 0;
+        value_ = block_ ? block_->first : 0;
+        return *this;
+    }
+
+    uint64_t delta;
+    offset_ += get_varint_(block_->data + offset_, delta);
+    value_ += unzigzag_(delta);
+    ++index_;
+    return *this;
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::const_iterator::operator++(int) {
+    const_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, typename Allocator>
+bool CompressedList<T, Allocator>::const_iterator::operator==(
+    const const_iterator &rhs) const {
+    return block_ == rhs.block_ && index_ == rhs.index_;
+}
+
+template <typename T, typename Allocator>
+bool CompressedList<T, Allocator>::const_iterator::operator!=(
+    const const_iterator &rhs) const {
+    return !(*this == rhs);
+}
+
+/*
+ *
+ *      Кодирование
+ *
+ */
+
+/*
+ *  Разность считаем по модулю 2^64 и смотрим на нее как на знаковую:
+ * маленькие по модулю разности обоих знаков становятся маленькими числами
+ */
+template <typename T, typename Allocator>
+uint64_t CompressedList<T, Allocator>::zigzag_(uint64_t delta) {
+    return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+template <typename T, typename Allocator>
+uint64_t CompressedList<T, Allocator>::unzigzag_(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::put_varint_(unsigned char *out,
+                                                  uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = static_cast<unsigned char>(value);
+    return length;
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::varint_length_(uint64_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++length;
+    }
+    return length;
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::get_varint_(const unsigned char *in,
+                                                  uint64_t &value) {
+    value = 0;
+    size_t length = 0;
+    unsigned shift = 0;
+    while (in[length] & 0x80) {
+        value |= static_cast<uint64_t>(in[length++] & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint64_t>(in[length++]) << shift;
+    return length;
+}
+
+/*
+ *  Распаковка блока целиком
+ *  Если в следующих 8 байтах ни у одного нет старшего бита, это 8
+ * однобайтовых разностей: разбираем их без ветвлений на каждый байт
+ */
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::decode_(const Block *block, uint64_t *out) {
+    size_t count = block->count;
+    const unsigned char *data = block->data;
+    size_t bytes = block->bytes;
+
+    out[0] = block->first;
+    size_t i = 1;
+    size_t offset = 0;
+
+    while (i < count) {
+        if (offset + 8 <= bytes && i + 8 <= count) {
+            uint64_t word;
+            std::memcpy(&word, data + offset, sizeof(word));
+            if ((word & 0x8080808080808080ull) == 0) {
+                for (size_t j = 0; j < 8; j++) {
+                    uint64_t zz = data[offset + j];
+                    out[i + j] = out[i + j - 1] + ((zz >> 1) ^ (0 - (zz & 1)));
+                }
+                i += 8;
+                offset += 8;
+                continue;
+            }
+        }
+
+        uint64_t delta;
+        offset += get_varint_(data + offset, delta);
+        out[i] = out[i - 1] + unzigzag_(delta);
+        ++i;
+    }
+
+    return count;
+}
+
+/*
+ *  Дописать значение в конец блока, false - если разности не влезают в
+ * limit байт
+ */
+template <typename T, typename Allocator>
+bool CompressedList<T, Allocator>::append_to_(Block *block, uint64_t value,
+                                              size_t limit) {
+    if (block->count == 0) {
+        block->first = block->last = value;
+        block->count = 1;
+        return true;
+    }
+
+    unsigned char buffer[10];
+    size_t length = put_varint_(buffer, zigzag_(value - block->last));
+    if (block->bytes + length > limit) {
+        return false;
+    }
+
+    std::memcpy(block->data + block->bytes, buffer, length);
+    block->bytes += static_cast<uint16_t>(length);
+    block->count++;
+    block->last = value;
+    return true;
+}
+
+/*
+ *  Записать values в block, а то, что не влезло, - в блоки после него
+ *  Если блоков нужно несколько, байты делятся между ними поровну: иначе
+ * при вставках в середину полный блок каждый раз отдавал бы новому
+ * блоку по одному значению. spare - следующий блок, который уже
+ * распакован в values: его переиспользуем, а если не понадобился,
+ * освобождаем
+ */
+template <typename T, typename Allocator>
+void CompressedList<T, Allocator>::encode_(Block *block, const uint64_t *values,
+                                           size_t count, Block *spare) {
+    size_t bytes = 0;
+    for (size_t i = 1; i < count; i++) {
+        bytes += varint_length_(zigzag_(values[i] - values[i - 1]));
+    }
+
+    // с запасом на одну разность, чтобы последнему блоку не осталось
+    // больше, чем остальным
+    size_t parts = (bytes + payload_ - 1) / payload_;
+    size_t limit = payload_;
+    if (parts > 1) {
+        limit = (bytes + parts - 1) / parts + 10;
+        if (limit > payload_) {
+            limit = payload_;
+        }
+    }
+
+    block->count = 0;
+    block->bytes = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (append_to_(block, values[i], limit)) {
+            continue;
+        }
+        if (spare) {
+            block = spare;
+            spare = nullptr;
+            block->count = 0;
+            block->bytes = 0;
+        } else {
+            block = new_block_after_(block);
+        }
+        append_to_(block, values[i], limit);
+    }
+
+    if (spare) {
+        delete_block_(spare);
+    }
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::Block *
+CompressedList<T, Allocator>::new_block_after_(Block *prev) {
+    Block *block = block_allocator_traits_::allocate(block_allocator_, 1);
+    block->count = 0;
+    block->bytes = 0;
+
+    block->prev = prev;
+    block->next = prev ? prev->next : head_;
+    if (block->next) {
+        block->next->prev = block;
+    } else {
+        tail_ = block;
+    }
+    if (prev) {
+        prev->next = block;
+    } else {
+        head_ = block;
+    }
+
+    ++blocks_;
+    return block;
+}
+
+template <typename T, typename Allocator>
+void CompressedList<T, Allocator>::delete_block_(Block *block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        head_ = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    } else {
+        tail_ = block->prev;
+    }
+
+    block_allocator_traits_::deallocate(block_allocator_, block, 1);
+    --blocks_;
+}
+
+/*
+ *
+ *      CompressedList
+ *
+ */
+
+template <typename T, typename Allocator>
+CompressedList<T, Allocator>::CompressedList(const Allocator &alloc)
+        : block_allocator_(alloc) {}
+
+template <typename T, typename Allocator>
+CompressedList<T, Allocator>::CompressedList(const CompressedList &rhs)
+        : block_allocator_(block_allocator_traits_::
+                               select_on_container_copy_construction(
+                                   rhs.block_allocator_)) {
+    rhs.for_each([this](T value) { push_back(value); });
+}
+
+template <typename T, typename Allocator>
+CompressedList<T, Allocator> &CompressedList<T, Allocator>::operator=(
+    const CompressedList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+    rhs.for_each([this](T value) { push_back(value); });
+    return *this;
+}
+
+template <typename T, typename Allocator>
+CompressedList<T, Allocator>::~CompressedList() {
+    clear();
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, typename Allocator>
+bool CompressedList<T, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, typename Allocator>
+void CompressedList<T, Allocator>::clear() {
+    while (head_) {
+        delete_block_(head_);
+    }
+    size_ = 0;
+}
+
+template <typename T, typename Allocator>
+T CompressedList<T, Allocator>::front() const {
+    return static_cast<T>(head_->first);
+}
+
+template <typename T, typename Allocator>
+T CompressedList<T, Allocator>::back() const {
+    return static_cast<T>(tail_->last);
+}
+
+template <typename T, typename Allocator>
+void CompressedList<T, Allocator>::push_back(T value) {
+    uint64_t bits = static_cast<uint64_t>(value);
+    if (tail_ == nullptr || !append_to_(tail_, bits)) {
+        append_to_(new_block_after_(tail_), bits);
+    }
+    ++size_;
+}
+
+template <typename T, typename Allocator>
+void CompressedList<T, Allocator>::push_front(T value) {
+    insert(begin(), value);
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::begin() const {
+    return head_ ? const_iterator(head_, 0, 0, head_->first) : end();
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::cbegin() const {
+    return begin();
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::end() const {
+    return const_iterator();
+}
+
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::cend() const {
+    return end();
+}
+
+/*
+ *  Итератор на index-й элемент, начиная с блока block (если блок
+ * кончился - идем в следующие)
+ */
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::iterator_at_(Block *block, size_t index) const {
+    while (block && index >= block->count) {
+        index -= block->count;
+        block = block->next;
+    }
+    if (block == nullptr) {
+        return end();
+    }
+
+    const_iterator it(block, 0, 0, block->first);
+    for (size_t i = 0; i < index; i++) {
+        ++it;
+    }
+    return it;
+}
+
+/*
+ *  Вставка перед iter на уровне блока: распаковали, вставили,
+ * запаковали обратно
+ *  Если блок почти полон, а в следующем есть место, распаковываем и его:
+ * encode_ поделит значения между ними, и новый блок не понадобится
+ */
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::insert(const_iterator iter, T value) {
+    if (iter.block_ == nullptr) {
+        push_back(value);
+        return iterator_at_(tail_, tail_->count - 1);
+    }
+
+    Block *block = iter.block_;
+    size_t index = iter.index_;
+
+    uint64_t values[2 * max_count_ + 1];
+    size_t count = decode_(block, values);
+    for (size_t i = count; i > index; i--) {
+        values[i] = values[i - 1];
+    }
+    values[index] = static_cast<uint64_t>(value);
+    ++count;
+
+    // одна разность стала двумя: это до 20 байт varint
+    Block *spare = nullptr;
+    Block *next = block->next;
+    if (size_t(block->bytes) + 20 > payload_ && next &&
+        next->bytes < payload_ / 2) {
+        count += decode_(next, values + count);
+        spare = next;
+    }
+
+    encode_(block, values, count, spare);
+    ++size_;
+
+    return iterator_at_(block, index);
+}
+
+/*
+ *  Удаление на уровне блока. Если блок стал заполнен меньше чем
+ * наполовину, распаковываем вместе с ним следующий: encode_ сольет их в
+ * один блок или поделит поровну
+ */
+template <typename T, typename Allocator>
+typename CompressedList<T, Allocator>::const_iterator
+CompressedList<T, Allocator>::erase(const_iterator iter) {
+    Block *block = iter.block_;
+    size_t index = iter.index_;
+    --size_;
+
+    if (block->count == 1) {
+        Block *next = block->next;
+        delete_block_(block);
+        return next ? const_iterator(next, 0, 0, next->first) : end();
+    }
+
+    uint64_t values[2 * max_count_];
+    size_t count = decode_(block, values);
+    for (size_t i = index; i + 1 < count; i++) {
+        values[i] = values[i + 1];
+    }
+    --count;
+
+    Block *spare = nullptr;
+    Block *next = block->next;
+    if (next && block->bytes < payload_ / 2) {
+        count += decode_(next, values + count);
+        spare = next;
+    }
+
+    encode_(block, values, count, spare);
+    return iterator_at_(block, index);
+}
+
+/*
+ *  Быстрый проход: блок распаковывается целиком в буфер на стеке
+ */
+template <typename T, typename Allocator>
+template <typename Function>
+void CompressedList<T, Allocator>::for_each(Function f) const {
+    uint64_t values[max_count_];
+    for (const Block *block = head_; block; block = block->next) {
+        size_t count = decode_(block, values);
+        for (size_t i = 0; i < count; i++) {
+            f(static_cast<T>(values[i]));
+        }
+    }
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::block_count() const {
+    return blocks_;
+}
+
+template <typename T, typename Allocator>
+size_t CompressedList<T, Allocator>::memory_usage() const {
+    return sizeof(*this) + blocks_ * sizeof(Block);
+}
+
+template <typename T, typename Allocator>
+Allocator CompressedList<T, Allocator>::get_allocator() const {
+    return Allocator(block_allocator_);
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <mutex>
+
+/*
+ *
+ *      ConcurrentFixedAllocator
+ *
+ *      Потокобезопасная обертка над FixedAllocator того же размера
+ *
+ *      У каждого потока свой кэш свободных блоков. Обычно allocate и
+ * deallocate работают только с ним, без блокировок. К общему пулу ходим
+ * под мьютексом и сразу за пачкой: забрать batch_ блоков через
+ * allocate_bulk или вернуть batch_ лишних
+ *
+ *      Общий пул - свой FixedAllocator, а не синглтон
+ * FixedAllocator::getFixedAllocator(): тот однопоточный, и им параллельно
+ * пользуются FastAllocator и PoolAllocator того же размера
+ *
+ *      Синглтон, как и FixedAllocator
+ *
+ */
+
+template <size_t chunkSize>
+struct ConcurrentFixedAllocator {
+private:
+    static const size_t batch_ = 32;
+
+    /*
+     *  Кэш без деструктора: thread_local других структур (например
+     * EpochDomain) могут освобождать память, когда поток уже завершается,
+     * и кэш должен быть еще жив. Возврат блоков в общий пул делает
+     * отдельный CacheGuard_, после него все идет сразу в общий пул
+     */
+    struct Cache_ {
+        void *blocks[2 * batch_];
+        size_t size;
+        bool exited;
+    };
+
+    struct CacheGuard_ {
+        ~CacheGuard_();
+    };
+
+    std::mutex mutex_;
+    FixedAllocator<chunkSize> central_;
+
+    static Cache_ &cache_();
+
+    void refill_(Cache_ &);
+    void flush_(Cache_ &, size_t count);
+
+    ConcurrentFixedAllocator();
+
+public:
+    static ConcurrentFixedAllocator<chunkSize> *getConcurrentFixedAllocator();
+
+    ConcurrentFixedAllocator(const ConcurrentFixedAllocator &) = delete;
+    ConcurrentFixedAllocator &operator=(const ConcurrentFixedAllocator &) =
+        delete;
+
+    void *allocate();
+    void deallocate(void *ptr);
+
+    // сколько блоков сейчас лежит в кэше текущего потока
+    size_t cached() const;
+};
+
+template <size_t chunkSize>
+ConcurrentFixedAllocator<chunkSize>::ConcurrentFixedAllocator() {}
+
+/*
+ *  Статическая переменная функции инициализируется потокобезопасно, в
+ * отличие от указателя в FixedAllocator. Объект, как и FixedAllocator,
+ * никогда не удаляется: блоки могут вернуть из деструкторов других
+ * статических и thread_local объектов уже при выходе из программы
+ */
+template <size_t chunkSize>
+ConcurrentFixedAllocator<chunkSize> *
+ConcurrentFixedAllocator<chunkSize>::getConcurrentFixedAllocator() {
+    static ConcurrentFixedAllocator<chunkSize> *allocator =
+        new ConcurrentFixedAllocator<chunkSize>();
+    return allocator;
+}
+
+template <size_t chunkSize>
+typename ConcurrentFixedAllocator<chunkSize>::Cache_ &
+ConcurrentFixedAllocator<chunkSize>::cache_() {
+    static thread_local Cache_ cache;
+    static thread_local CacheGuard_ guard;
+    (void)guard;
+    return cache;
+}
+
+/*
+ *  Поток завершается - его блоки возвращаются в общий пул
+ */
+template <size_t chunkSize>
+ConcurrentFixedAllocator<chunkSize>::CacheGuard_::~CacheGuard_() {
+    Cache_ &cache = cache_();
+    getConcurrentFixedAllocator()->flush_(cache, cache.size);
+    cache.exited = true;
+}
+
+template <size_t chunkSize>
+void ConcurrentFixedAllocator<chunkSize>::refill_(Cache_ &cache) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    central_.allocate_bulk(cache.blocks + cache.size, batch_);
+    cache.size += batch_;
+}
+
+template <size_t chunkSize>
+void ConcurrentFixedAllocator<chunkSize>::flush_(Cache_ &cache,
+                                                 size_t count) {
+    size_t keep = cache.size - count;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = keep; i < cache.size; i++) {
+        central_.deallocate(cache.blocks[i]);
+    }
+    cache.size = keep;
+}
+
+template <size_t chunkSize>
+void *ConcurrentFixedAllocator<chunkSize>::allocate() {
+    Cache_ &cache = cache_();
+    if (cache.exited) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return central_.allocate();
+    }
+
+    if (cache.size == 0) {
+        refill_(cache);
+    }
+    return cache.blocks[--cache.size];
+}
+
+/*
+ *  Блок мог быть выделен в другом потоке - неважно, он попадает в кэш
+ * того потока, который освобождает
+ */
+template <size_t chunkSize>
+void ConcurrentFixedAllocator<chunkSize>::deallocate(void *ptr) {
+    Cache_ &cache = cache_();
+    if (cache.exited) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        central_.deallocate(ptr);
+        return;
+    }
+
+    if (cache.size == 2 * batch_) {
+        flush_(cache, batch_);
+    }
+    cache.blocks[cache.size++] = ptr;
+}
+
+template <size_t chunkSize>
+size_t ConcurrentFixedAllocator<chunkSize>::cached() const {
+    const Cache_ &cache = cache_();
+    return cache.exited ? 0 : cache.size;
+}
+
+/*
+ *
+ *      ConcurrentFastAllocator
+ *
+ *      То же, что FastAllocator, только маленькие объекты берутся из
+ * ConcurrentFixedAllocator, так что выделять и освобождать можно из
+ * любых потоков
+ *
+ */
+
+template <typename T>
+struct ConcurrentFastAllocator {
+private:
+    // как у FastAllocator: пулы не уменьшаются, крупное - через new
+    static const size_t maxSize = 32;
+
+public:
+    ConcurrentFastAllocator() = default;
+    template <typename U>
+    ConcurrentFastAllocator(const ConcurrentFastAllocator<U>);
+
+    T *allocate(size_t);
+    void deallocate(T *, size_t);
+
+    using value_type = T;
+    using ptr = T *;
+    using const_pointer = const T *;
+    using reference = T &;
+    using const_reference = const T &;
+
+    template <typename U>
+    struct rebind;
+};
+
+template <typename T>
+template <typename U>
+ConcurrentFastAllocator<T>::ConcurrentFastAllocator(
+    const ConcurrentFastAllocator<U>) {}
+
+template <typename T>
+T *ConcurrentFastAllocator<T>::allocate(size_t n) {
+    if (sizeof(T) <= maxSize && n <= 1) {
+        return reinterpret_cast<T *>(
+            ConcurrentFixedAllocator<sizeof(T)>::getConcurrentFixedAllocator()
+                ->allocate());
+    } else {
+        return reinterpret_cast<T *>(::operator new(n * sizeof(T)));
+    }
+}
+
+template <typename T>
+void ConcurrentFastAllocator<T>::deallocate(T *point, size_t n) {
+    if (sizeof(T) <= maxSize && n <= 1) {
+        ConcurrentFixedAllocator<sizeof(T)>::getConcurrentFixedAllocator()
+            ->deallocate(point);
+    } else {
+        ::operator delete(point);
+    }
+}
+
+template <typename T>
+template <typename U>
+struct ConcurrentFastAllocator<T>::rebind {
+    typedef ConcurrentFastAllocator<U> other;
+};
+
+template <typename T, typename U>
+bool operator==(const ConcurrentFastAllocator<T> &,
+                const ConcurrentFastAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ConcurrentFastAllocator<T> &,
+                const ConcurrentFastAllocator<U> &) {
+    return false;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ *      EpochDomain
+ *
+ *      Эпохи для отложенного освобождения памяти (epoch-based reclamation)
+ *
+ *      Читатель на входе в критическую секцию записывает в свой слот
+ * текущую глобальную эпоху, на выходе - ноль. Писатель, выкинув узел из
+ * структуры, запоминает эпоху, в которую это сделал. Узел можно
+ * освободить, когда у всех активных читателей эпоха стала больше: они
+ * вошли уже после удаления и узла не видели
+ *
+ *      Синглтон, как FixedAllocator и ThreadPool. Слот у потока один на
+ * всю прогу, занимается при первом входе и освобождается, когда поток
+ * завершается
+ *
+ *      Для структур, где удаляют из разных потоков, есть retire(): у
+ * каждого потока свой список выкинутого, который разбирается пачками
+ *
+ */
+
+struct EpochDomain {
+private:
+    struct alignas(64) Slot_ {
+        std::atomic<uint64_t> epoch{0};  // 0 - поток не читает
+        std::atomic<bool> used{false};
+    };
+
+    struct Retired_ {
+        void *ptr;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    struct LocalState_ {
+        Slot_ *slot = nullptr;
+        size_t depth = 0;
+        std::vector<Retired_> retired;
+
+        ~LocalState_();
+    };
+
+    static const size_t max_threads_ = 256;
+    static const size_t retire_batch_ = 64;
+
+    Slot_ slots_[max_threads_];
+    std::atomic<uint64_t> epoch_{1};
+
+    static LocalState_ &local_();
+    Slot_ *acquire_slot_();
+    void collect_(LocalState_ &);
+
+    EpochDomain() = default;
+
+public:
+    static EpochDomain *getEpochDomain();
+
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    void enter();
+    void exit();
+
+    uint64_t current() const;
+    uint64_t advance();
+    uint64_t min_active() const;
+
+    void retire(void *ptr, void (*deleter)(void *));
+    void flush();
+};
+
+inline EpochDomain::LocalState_ &EpochDomain::local_() {
+    static thread_local LocalState_ state;
+    return state;
+}
+
+/*
+ *  Поток завершается: дожидаемся, пока все его выкинутое можно будет
+ * освободить (остальные потоки сидят в секциях недолго)
+ */
+inline EpochDomain::LocalState_::~LocalState_() {
+    while (!retired.empty()) {
+        getEpochDomain()->collect_(*this);
+        if (!retired.empty()) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (slot) {
+        slot->epoch.store(0, std::memory_order_release);
+        slot->used.store(false, std::memory_order_release);
+    }
+}
+
+inline EpochDomain *EpochDomain::getEpochDomain() {
+    static EpochDomain domain;
+    return &domain;
+}
+
+inline EpochDomain::Slot_ *EpochDomain::acquire_slot_() {
+    for (size_t i = 0; i < max_threads_; i++) {
+        bool expected = false;
+        if (!slots_[i].used.load(std::memory_order_relaxed) &&
+            slots_[i].used.compare_exchange_strong(expected, true,
+                                                   std::memory_order_acquire)) {
+            return &slots_[i];
+        }
+    }
+    throw std::runtime_error("EpochDomain: too many reader threads");
+}
+
+/*
+ *  Вход в критическую секцию читателя, вложенные входы просто считаются
+ *  Барьер нужен, чтобы запись эпохи стала видна писателю раньше, чем мы
+ * прочитаем хоть один указатель
+ */
+inline void EpochDomain::enter() {
+    LocalState_ &state = local_();
+    if (state.depth++ > 0) {
+        return;
+    }
+
+    if (state.slot == nullptr) {
+        state.slot = acquire_slot_();
+    }
+    state.slot->epoch.store(epoch_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void EpochDomain::exit() {
+    LocalState_ &state = local_();
+    if (--state.depth > 0) {
+        return;
+    }
+    state.slot->epoch.store(0, std::memory_order_release);
+}
+
+inline uint64_t EpochDomain::current() const {
+    return epoch_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t EpochDomain::advance() {
+    return epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+/*
+ *  Самая старая эпоха среди тех, кто сейчас читает
+ *  Все, что выкинуто в эпоху меньше этой, уже никто не видит
+ */
+inline uint64_t EpochDomain::min_active() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint64_t result = epoch_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < max_threads_; i++) {
+        uint64_t epoch = slots_[i].epoch.load(std::memory_order_acquire);
+        if (epoch != 0 && epoch < result) {
+            result = epoch;
+        }
+    }
+    return result;
+}
+
+/*
+ *  Отложенное удаление: deleter(ptr) позовется, когда ни один читатель
+ * уже не сможет увидеть ptr
+ *  Эпоха читается после того, как объект выкинут из структуры
+ */
+inline void EpochDomain::retire(void *ptr, void (*deleter)(void *)) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    LocalState_ &state = local_();
+    state.retired.push_back(Retired_{ptr, deleter, current()});
+    if (state.retired.size() >= retire_batch_) {
+        collect_(state);
+    }
+}
+
+/*
+ *  Освободить то, что уже можно, не дожидаясь целой пачки
+ */
+inline void EpochDomain::flush() {
+    collect_(local_());
+}
+
+inline void EpochDomain::collect_(LocalState_ &state) {
+    advance();
+    uint64_t safe = min_active();
+
+    size_t kept = 0;
+    for (size_t i = 0; i < state.retired.size(); i++) {
+        if (state.retired[i].epoch < safe) {
+            state.retired[i].deleter(state.retired[i].ptr);
+        } else {
+            state.retired[kept++] = state.retired[i];
+        }
+    }
+    state.retired.resize(kept);
+}
+
+/*
+ *  RAII для критической секции читателя
+ */
+struct EpochGuard {
+    EpochGuard() {
+        EpochDomain::getEpochDomain()->enter();
+    }
+
+    ~EpochGuard() {
+        EpochDomain::getEpochDomain()->exit();
+    }
+
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+};
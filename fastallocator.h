@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <utility>
 
 /*
  *
@@ -20,9 +23,15 @@
  *
  */
 
+template <size_t chunkSize>
+struct ConcurrentFixedAllocator;
+
 template <size_t chunkSize>
 struct FixedAllocator {
 private:
+    // заводит себе отдельный экземпляр, не синглтон
+    friend struct ConcurrentFixedAllocator<chunkSize>;
+
     size_t capacity_ = 32;
     size_t size_ = 0;
 
@@ -41,7 +50,12 @@ public:
     ~FixedAllocator();
 
     void *allocate();
+    void allocate_bulk(void **out, size_t count);
     void deallocate(void* ptr);
+
+    // сколько блоков взято у системы всего и сколько из них сейчас свободно
+    size_t reserved_blocks() const;
+    size_t free_blocks() const;
 };
 
 template <size_t chunkSize>
@@ -100,6 +114,32 @@ void *FixedAllocator<chunkSize>::allocate() {
     return memory;
 }
 
+/*
+ *  Сразу много блоков: сначала разбираем возвращенные, остальное режем
+ * подряд из текущего куска, так что узлы ложатся в память плотно
+ */
+template <size_t chunkSize>
+void FixedAllocator<chunkSize>::allocate_bulk(void **out, size_t count) {
+    size_t i = 0;
+    while (i < count && !returned_.empty()) {
+        out[i++] = returned_.back();
+        returned_.pop_back();
+    }
+
+    while (i < count) {
+        if (size_ == capacity_) {
+            allocate_memory_();
+        }
+
+        size_t take = std::min(count - i, capacity_ - size_);
+        char *base = reinterpret_cast<char *>(chunks_.back()) + size_ * chunkSize;
+        for (size_t j = 0; j < take; j++) {
+            out[i++] = base + j * chunkSize;
+        }
+        size_ += take;
+    }
+}
+
 /*
  *  Ничего не делаем
  */
@@ -108,6 +148,22 @@ void FixedAllocator<chunkSize>::deallocate(void* ptr) {
     returned_.push_back(ptr);
 }
 
+/*
+ *  Куски идут по 32, 64, 128, ... блоков, последний - capacity_
+ */
+template <size_t chunkSize>
+size_t FixedAllocator<chunkSize>::reserved_blocks() const {
+    return 2 * capacity_ - 32;
+}
+
+/*
+ *  Возвращенные плюс еще не нарезанный хвост последнего куска
+ */
+template <size_t chunkSize>
+size_t FixedAllocator<chunkSize>::free_blocks() const {
+    return returned_.size() + (capacity_ - size_);
+}
+
 /*
  *  Просто пройдемся и удалим все блоки памяти, которые мы аллоцировали
  */
@@ -126,8 +182,16 @@ FixedAllocator<chunkSize>::~FixedAllocator() {
  *      - Если мы пытаемся выделить
  *      небольшой кусок памяти (до maxSize), то используется FixedAllocator
  *      - Иначе обычный ::operator new()
+ *
+ *      FixedAllocator один на размер на весь процесс и без блокировок,
+ * поэтому FastAllocator (и PoolAllocator) не потокобезопасный, даже если
+ * сам контейнер под мьютексом: другой контейнер с узлами того же размера
+ * ходит в тот же пул. Из нескольких потоков - ConcurrentFastAllocator
  */
 
+template <typename T>
+struct PoolAllocator;
+
 template <typename T>
 struct FastAllocator {
 private:
@@ -137,8 +201,11 @@ public:
     FastAllocator() = default;
     template <typename U>
     FastAllocator(const FastAllocator<U>);
+    template <typename U>
+    FastAllocator(const PoolAllocator<U>);
 
     T *allocate(size_t);
+    void allocate_bulk(T **, size_t);
     void deallocate(T *, size_t);
 
     using value_type = T;
@@ -155,6 +222,10 @@ template <typename T>
 template <typename U>
 FastAllocator<T>::FastAllocator(const FastAllocator<U>) {}
 
+template <typename T>
+template <typename U>
+FastAllocator<T>::FastAllocator(const PoolAllocator<U>) {}
+
 template <typename T>
 T *FastAllocator<T>::allocate(size_t n) {
     if (sizeof(T) <= maxSize && n <= 1) {
@@ -165,6 +236,22 @@ T *FastAllocator<T>::allocate(size_t n) {
     }
 }
 
+/*
+ *  count отдельных объектов (не массив!), каждый потом освобождается
+ * через deallocate(ptr, 1)
+ */
+template <typename T>
+void FastAllocator<T>::allocate_bulk(T **out, size_t count) {
+    if (sizeof(T) <= maxSize) {
+        FixedAllocator<sizeof(T)>::getFixedAllocator()->allocate_bulk(
+            reinterpret_cast<void **>(out), count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = allocate(1);
+        }
+    }
+}
+
 template <typename T>
 void FastAllocator<T>::deallocate(T *point, size_t n) {
     if (sizeof(T) <= maxSize && n <= 1) {
@@ -180,6 +267,118 @@ struct FastAllocator<T>::rebind {
     typedef FastAllocator<U> other;
 };
 
+/*
+ *  Состояния у аллокатора нет, память из пула можно отдать через любой
+ * экземпляр
+ */
+template <typename T, typename U>
+bool operator==(const FastAllocator<T> &, const FastAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const FastAllocator<T> &, const FastAllocator<U> &) {
+    return false;
+}
+
+/*
+ *
+ *      PoolAllocator
+ *
+ *      FastAllocator без порога maxSize: любой одиночный объект берется из
+ * FixedAllocator своего размера, и только массивы - через ::operator new
+ *
+ *      Сам по себе не нужен, им пользуются контейнеры с крупными узлами
+ * (UnrolledList, CompressedList, ...), чтобы с FastAllocator их узлы
+ * все равно попадали в пулы. Порог у самого FastAllocator при этом не
+ * меняется для всех остальных
+ *
+ */
+
+template <typename T>
+struct PoolAllocator {
+public:
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>);
+    template <typename U>
+    PoolAllocator(const FastAllocator<U>);
+
+    T *allocate(size_t);
+    void allocate_bulk(T **, size_t);
+    void deallocate(T *, size_t);
+
+    using value_type = T;
+
+    template <typename U>
+    struct rebind;
+};
+
+template <typename T>
+template <typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>) {}
+
+template <typename T>
+template <typename U>
+PoolAllocator<T>::PoolAllocator(const FastAllocator<U>) {}
+
+template <typename T>
+T *PoolAllocator<T>::allocate(size_t n) {
+    if (n <= 1) {
+        return reinterpret_cast<T *>(
+            FixedAllocator<sizeof(T)>::getFixedAllocator()->allocate());
+    } else {
+        return reinterpret_cast<T *>(::operator new(n * sizeof(T)));
+    }
+}
+
+template <typename T>
+void PoolAllocator<T>::allocate_bulk(T **out, size_t count) {
+    FixedAllocator<sizeof(T)>::getFixedAllocator()->allocate_bulk(
+        reinterpret_cast<void **>(out), count);
+}
+
+template <typename T>
+void PoolAllocator<T>::deallocate(T *point, size_t n) {
+    if (n <= 1) {
+        FixedAllocator<sizeof(T)>::getFixedAllocator()->deallocate(point);
+    } else {
+        ::operator delete(point);
+    }
+}
+
+template <typename T>
+template <typename U>
+struct PoolAllocator<T>::rebind {
+    typedef PoolAllocator<U> other;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+    return false;
+}
+
+/*
+ *  rebind_alloc<U>, только FastAllocator превращается в PoolAllocator.
+ * Так контейнер с крупными узлами получает пулы, если его попросили
+ * работать с FastAllocator, а с любым другим аллокатором все как обычно
+ */
+template <typename Allocator, typename U>
+struct PoolRebind {
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<U>
+        type;
+};
+
+template <typename T, typename U>
+struct PoolRebind<FastAllocator<T>, U> {
+    typedef PoolAllocator<U> type;
+};
+
 /*
  *
  *      List<T, Allocator>
@@ -231,6 +430,26 @@ public:
     iterator insert(const_iterator, const T&);
     iterator erase(const_iterator);
 
+    template <typename ForwardIt>
+    iterator insert(const_iterator, ForwardIt, ForwardIt);
+
+    bool empty() const;
+    void clear();
+
+    void splice(const_iterator, List &);
+
+    void merge(List &);
+    template <typename Compare>
+    void merge(List &, Compare);
+
+    void sort();
+    template <typename Compare>
+    void sort(Compare);
+
+    template <typename, typename>
+    friend struct ListParallel;
+    template <typename, typename>
+    friend struct MpscQueue;
 
 private:
     struct Node {
@@ -249,6 +468,33 @@ private:
 
     void copy_(const List<T, Allocator> &);
 
+    /*
+     *  Кусок листа без сентинелов: first->prev и last->next никуда не
+     * смотрят, внутри все связи в обе стороны в порядке
+     */
+    struct Chain_ {
+        Node *first;
+        Node *last;
+    };
+
+    static const size_t bulk_nodes_ = 256;
+
+    template <typename NodeAllocator>
+    static auto allocate_nodes_(NodeAllocator &, Node **, size_t, int)
+        -> decltype(std::declval<NodeAllocator &>().allocate_bulk(
+                        std::declval<Node **>(), size_t()),
+                    void());
+    template <typename NodeAllocator>
+    static void allocate_nodes_(NodeAllocator &, Node **, size_t, long);
+
+    Chain_ detach_chain_();
+    void link_chain_(Node *, Chain_, size_t);
+
+    template <typename Compare>
+    static Chain_ merge_chains_(Chain_, Chain_, Compare &);
+    template <typename Compare>
+    static Chain_ sort_chain_(Node *&, size_t, Compare &);
+
     using node_allocator_type_ =
         typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
     using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
@@ -436,17 +682,18 @@ public:
 
     list_iterator();
     list_iterator(const list_iterator<typename std::remove_const<T>::type>& rhs);
+    list_iterator& operator=(const list_iterator& rhs) = default;
 
-    U& operator*();
-    U* operator->();
+    U& operator*() const;
+    U* operator->() const;
 
     list_iterator& operator++();
     list_iterator operator++(int);
     list_iterator& operator--();
     list_iterator operator--(int);
 
-    bool operator==(const list_iterator<U>& rhs);
-    bool operator!=(const list_iterator<U>& rhs);
+    bool operator==(const list_iterator<U>& rhs) const;
+    bool operator!=(const list_iterator<U>& rhs) const;
     friend class List<T, Allocator>;
 
 private:
@@ -455,6 +702,10 @@ private:
     Node* ptr_;
 };
 
+template <typename T, typename Allocator>
+template <typename U>
+List<T, Allocator>::list_iterator<U>::list_iterator() : ptr_(nullptr) {}
+
 template <typename T, typename Allocator>
 template <typename U>
 List<T, Allocator>::list_iterator<U>::list_iterator(Node* ptr) : ptr_(ptr) {}
@@ -467,14 +718,14 @@ List<T, Allocator>::list_iterator<U>::list_iterator(const list_iterator<typename
 
 template <typename T, typename Allocator>
 template <typename U>
-U& List<T, Allocator>::list_iterator<U>::operator*() {
+U& List<T, Allocator>::list_iterator<U>::operator*() const {
     return ptr_->elem_;
 }
 
 template <typename T, typename Allocator>
 template <typename U>
-U* List<T, Allocator>::list_iterator<U>::operator->() {
-    return &(ptr_->elem);
+U* List<T, Allocator>::list_iterator<U>::operator->() const {
+    return &(ptr_->elem_);
 }
 
 template <typename T, typename Allocator>
@@ -510,13 +761,13 @@ typename List<T, Allocator>::template list_iterator<U> List<T, Allocator>::list_
 
 template <typename T, typename Allocator>
 template <typename U>
-bool List<T, Allocator>::list_iterator<U>::operator==(const typename List<T, Allocator>::template list_iterator<U>& rhs) {
+bool List<T, Allocator>::list_iterator<U>::operator==(const typename List<T, Allocator>::template list_iterator<U>& rhs) const {
     return ptr_ == rhs.ptr_;
 }
 
 template <typename T, typename Allocator>
 template <typename U>
-bool List<T, Allocator>::list_iterator<U>::operator!=(const typename List<T, Allocator>::template list_iterator<U>& rhs) {
+bool List<T, Allocator>::list_iterator<U>::operator!=(const typename List<T, Allocator>::template list_iterator<U>& rhs) const {
     return ptr_ != rhs.ptr_;
 }
 
@@ -560,7 +811,7 @@ typename List<T, Allocator>::const_reverse_iterator List<T, Allocator>::crend()
 template <typename T, typename Allocator>
 typename List<T, Allocator>::iterator List<T, Allocator>::insert(const_iterator iter, const T& value) {
     insert_before_(iter.ptr_, value);
-    return iterator(iter.ptr_->next);
+    return iterator(iter.ptr_->prev);
 }
 
 template <typename T, typename Allocator>
@@ -569,3 +820,241 @@ typename List<T, Allocator>::iterator List<T, Allocator>::erase(const_iterator i
     erase_(iter.ptr_);
     return ret;
 }
+
+template <typename T, typename Allocator>
+bool List<T, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+/*
+ *  Отцепляем все элементы от сентинелов, лист становится пустым
+ *  Последний элемент цепочки смотрит в nullptr
+ */
+template <typename T, typename Allocator>
+typename List<T, Allocator>::Chain_ List<T, Allocator>::detach_chain_() {
+    if (size_ == 0) {
+        return Chain_{nullptr, nullptr};
+    }
+
+    Chain_ chain{begin_->next, end_->prev};
+    chain.last->next = nullptr;
+
+    begin_->next = end_;
+    end_->prev = begin_;
+    size_ = 0;
+
+    return chain;
+}
+
+/*
+ *  Вставляем готовую цепочку перед ptr за O(1)
+ */
+template <typename T, typename Allocator>
+void List<T, Allocator>::link_chain_(Node *ptr, Chain_ chain, size_t count) {
+    if (chain.first == nullptr) {
+        return;
+    }
+
+    chain.first->prev = ptr->prev;
+    chain.last->next = ptr;
+    ptr->prev->next = chain.first;
+    ptr->prev = chain.last;
+
+    size_ += count;
+}
+
+/*
+ *  Сливаем две отсортированные цепочки, просто перевешивая указатели
+ *  При равенстве сначала берем из a, так что слияние устойчивое
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+typename List<T, Allocator>::Chain_ List<T, Allocator>::merge_chains_(
+    Chain_ a, Chain_ b, Compare &comp) {
+    if (a.first == nullptr) {
+        return b;
+    }
+    if (b.first == nullptr) {
+        return a;
+    }
+
+    Node *first = nullptr;
+    Node *last = nullptr;
+    Node *x = a.first;
+    Node *y = b.first;
+
+    while (x && y) {
+        Node *taken;
+        if (comp(y->elem_, x->elem_)) {
+            taken = y;
+            y = y->next;
+        } else {
+            taken = x;
+            x = x->next;
+        }
+
+        taken->prev = last;
+        if (last) {
+            last->next = taken;
+        } else {
+            first = taken;
+        }
+        last = taken;
+    }
+
+    Node *rest = x ? x : y;
+    rest->prev = last;
+    last->next = rest;
+
+    return Chain_{first, x ? a.last : b.last};
+}
+
+/*
+ *  Сортировка слиянием сверху вниз, но без поиска середины:
+ *  cursor идет по цепочке и каждый раз откусывает один узел,
+ *  поэтому по списку мы проходим только при слияниях
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+typename List<T, Allocator>::Chain_ List<T, Allocator>::sort_chain_(
+    Node *&cursor, size_t count, Compare &comp) {
+    if (count == 0) {
+        return Chain_{nullptr, nullptr};
+    }
+
+    if (count == 1) {
+        Node *node = cursor;
+        cursor = cursor->next;
+        node->next = node->prev = nullptr;
+        return Chain_{node, node};
+    }
+
+    Chain_ left = sort_chain_(cursor, count / 2, comp);
+    Chain_ right = sort_chain_(cursor, count - count / 2, comp);
+
+    return merge_chains_(left, right, comp);
+}
+
+/*
+ *  Перекидываем все элементы rhs перед iter за O(1)
+ *  Аллокаторы должны быть равны, как и в std::list
+ */
+template <typename T, typename Allocator>
+void List<T, Allocator>::splice(const_iterator iter, List &rhs) {
+    if (this == &rhs || rhs.size_ == 0) {
+        return;
+    }
+
+    size_t count = rhs.size_;
+    link_chain_(iter.ptr_, rhs.detach_chain_(), count);
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::merge(List &rhs) {
+    merge(rhs, std::less<T>());
+}
+
+template <typename T, typename Allocator>
+template <typename Compare>
+void List<T, Allocator>::merge(List &rhs, Compare comp) {
+    if (this == &rhs) {
+        return;
+    }
+
+    size_t count = size_ + rhs.size_;
+    Chain_ a = detach_chain_();
+    Chain_ b = rhs.detach_chain_();
+
+    link_chain_(end_, merge_chains_(a, b, comp), count);
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::sort() {
+    sort(std::less<T>());
+}
+
+/*
+ *  Узлы не копируются и не переаллоцируются, только перевешиваются,
+ *  так что итераторы остаются валидными
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+void List<T, Allocator>::sort(Compare comp) {
+    size_t count = size_;
+    Node *cursor = detach_chain_().first;
+
+    link_chain_(end_, sort_chain_(cursor, count, comp), count);
+}
+
+template <typename T, typename Allocator>
+const size_t List<T, Allocator>::bulk_nodes_;
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::clear() {
+    while (size_ > 0) {
+        pop_back();
+    }
+}
+
+/*
+ *  Если аллокатор умеет выдавать узлы пачкой (FastAllocator умеет),
+ * берем пачкой, иначе по одному
+ */
+template <typename T, typename Allocator>
+template <typename NodeAllocator>
+auto List<T, Allocator>::allocate_nodes_(NodeAllocator &alloc, Node **out,
+                                         size_t count, int)
+    -> decltype(std::declval<NodeAllocator &>().allocate_bulk(
+                    std::declval<Node **>(), size_t()),
+                void()) {
+    alloc.allocate_bulk(out, count);
+}
+
+template <typename T, typename Allocator>
+template <typename NodeAllocator>
+void List<T, Allocator>::allocate_nodes_(NodeAllocator &alloc, Node **out,
+                                         size_t count, long) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = node_allocator_traits_::allocate(alloc, 1);
+    }
+}
+
+/*
+ *  Вставка диапазона перед iter
+ *  Узлы выделяются пачками по bulk_nodes_, собираются в цепочку и
+ * вешаются в лист одним куском
+ */
+template <typename T, typename Allocator>
+template <typename ForwardIt>
+typename List<T, Allocator>::iterator List<T, Allocator>::insert(
+    const_iterator iter, ForwardIt first, ForwardIt last) {
+    size_t count = std::distance(first, last);
+    if (count == 0) {
+        return iterator(iter.ptr_);
+    }
+
+    Node *nodes[bulk_nodes_];
+    Chain_ chain{nullptr, nullptr};
+
+    for (size_t done = 0; done < count;) {
+        size_t take = std::min(count - done, bulk_nodes_);
+        allocate_nodes_(node_allocator_, nodes, take, 0);
+
+        for (size_t i = 0; i < take; i++, ++first) {
+            Node *node = nodes[i];
+            node_allocator_traits_::construct(node_allocator_, node, *first);
+
+            node->prev = chain.last;
+            if (chain.last) {
+                chain.last->next = node;
+            } else {
+                chain.first = node;
+            }
+            chain.last = node;
+        }
+        done += take;
+    }
+
+    link_chain_(iter.ptr_, chain, count);
+    return iterator(chain.first);
+}
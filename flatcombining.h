@@ -0,0 +1,303 @@
+#pragma once
+
+#include "fastallocator.h"
+#include "spinlock.h"
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+/*
+ *
+ *      ThreadIndex
+ *
+ *      Маленький номер текущего потока: от 0 до max_threads - 1, живые
+ * потоки получают разные номера. Поток занимает номер при первом
+ * обращении и отдает, когда завершается, так что номера переиспользуются
+ *
+ */
+
+struct ThreadIndex {
+    static const size_t max_threads = 256;
+
+    static size_t current();
+
+    // номера всех потоков, когда-либо бравших номер, меньше limit()
+    static size_t limit();
+
+private:
+    struct Holder_ {
+        size_t index;
+
+        Holder_();
+        ~Holder_();
+    };
+
+    static std::atomic<bool> *used_();
+    static std::atomic<size_t> &limit_();
+};
+
+inline std::atomic<bool> *ThreadIndex::used_() {
+    static std::atomic<bool> used[max_threads];
+    return used;
+}
+
+inline std::atomic<size_t> &ThreadIndex::limit_() {
+    static std::atomic<size_t> limit{0};
+    return limit;
+}
+
+inline ThreadIndex::Holder_::Holder_() {
+    std::atomic<bool> *used = used_();
+    for (index = 0; index < max_threads; index++) {
+        bool expected = false;
+        if (used[index].compare_exchange_strong(expected, true)) {
+            break;
+        }
+    }
+    if (index == max_threads) {
+        throw std::runtime_error("ThreadIndex: too many threads");
+    }
+
+    size_t limit = limit_().load();
+    while (limit < index + 1 &&
+           !limit_().compare_exchange_weak(limit, index + 1)) {
+    }
+}
+
+inline ThreadIndex::Holder_::~Holder_() {
+    used_()[index].store(false, std::memory_order_release);
+}
+
+inline size_t ThreadIndex::current() {
+    static thread_local Holder_ holder;
+    return holder.index;
+}
+
+inline size_t ThreadIndex::limit() {
+    return limit_().load(std::memory_order_acquire);
+}
+
+/*
+ *
+ *      FlatCombiningList<T, Allocator>
+ *
+ *      List для многих потоков через flat combining
+ *
+ *      Поток не воюет за замок, а записывает свою операцию в свой слот и
+ * ждет. Тот, кому замок достался (комбайнер), проходит по всем слотам и
+ * выполняет все накопившиеся операции подряд: лист все время в кэше
+ * одного ядра, а замок передается один раз на пачку, а не на каждую
+ * операцию
+ *
+ *      Операция - это любая функция от List&, так что кроме готовых
+ * push/pop можно выполнить что угодно через apply
+ *
+ *      Лист трогает только комбайнер под замком
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct FlatCombiningList {
+    explicit FlatCombiningList(const Allocator &alloc = Allocator());
+
+    FlatCombiningList(const FlatCombiningList &) = delete;
+    FlatCombiningList &operator=(const FlatCombiningList &) = delete;
+
+    void push_back(const T &value);
+    void push_front(const T &value);
+    bool try_pop_front(T &out);
+    bool try_pop_back(T &out);
+    void insert_sorted(const T &value);
+    bool erase_first(const T &value);
+
+    template <typename Function>
+    void apply(Function f);
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    typedef void (*Operation_)(List<T, Allocator> &, void *);
+
+    struct alignas(64) Record_ {
+        std::atomic<bool> pending{false};
+        Operation_ operation = nullptr;
+        void *context = nullptr;
+        std::exception_ptr error;
+    };
+
+    template <typename Function>
+    static void call_(List<T, Allocator> &list, void *context);
+
+    void submit_(Operation_ operation, void *context);
+    void combine_();
+
+    static const size_t combine_passes_ = 2;
+    static const size_t spin_tries_ = 128;
+
+    Record_ records_[ThreadIndex::max_threads];
+
+    alignas(64) SpinLock lock_;
+    List<T, Allocator> list_;
+    std::atomic<size_t> size_{0};
+};
+
+template <typename T, typename Allocator>
+FlatCombiningList<T, Allocator>::FlatCombiningList(const Allocator &alloc)
+        : list_(alloc) {}
+
+template <typename T, typename Allocator>
+template <typename Function>
+void FlatCombiningList<T, Allocator>::call_(List<T, Allocator> &list,
+                                            void *context) {
+    (*static_cast<Function *>(context))(list);
+}
+
+/*
+ *  Публикуем операцию и ждем, пока ее выполнит комбайнер. Если замок
+ * свободен - сами становимся комбайнером
+ */
+template <typename T, typename Allocator>
+void FlatCombiningList<T, Allocator>::submit_(Operation_ operation,
+                                              void *context) {
+    Record_ &record = records_[ThreadIndex::current()];
+    record.operation = operation;
+    record.context = context;
+    record.pending.store(true, std::memory_order_release);
+
+    // потоков может быть больше, чем ядер: долго не крутимся
+    size_t spins = 0;
+    while (record.pending.load(std::memory_order_acquire)) {
+        if (lock_.try_lock()) {
+            combine_();
+            lock_.unlock();
+        } else if (++spins < spin_tries_) {
+            SpinLock::pause();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    if (record.error) {
+        std::exception_ptr error = std::move(record.error);
+        record.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+/*
+ *  Несколько проходов по слотам: пока комбайнер работает, соседи успевают
+ * положить новые операции
+ */
+template <typename T, typename Allocator>
+void FlatCombiningList<T, Allocator>::combine_() {
+    size_t limit = ThreadIndex::limit();
+    for (size_t pass = 0; pass < combine_passes_; pass++) {
+        bool found = false;
+        for (size_t i = 0; i < limit; i++) {
+            Record_ &record = records_[i];
+            if (!record.pending.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            try {
+                record.operation(list_, record.context);
+            } catch (...) {
+                record.error = std::current_exception();
+            }
+            record.pending.store(false, std::memory_order_release);
+            found = true;
+        }
+        if (!found) {
+            break;
+        }
+    }
+    size_.store(list_.size(), std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator>
+template <typename Function>
+void FlatCombiningList<T, Allocator>::apply(Function f) {
+    submit_(&call_<Function>, &f);
+}
+
+template <typename T, typename Allocator>
+void FlatCombiningList<T, Allocator>::push_back(const T &value) {
+    apply([&value](List<T, Allocator> &list) { list.push_back(value); });
+}
+
+template <typename T, typename Allocator>
+void FlatCombiningList<T, Allocator>::push_front(const T &value) {
+    apply([&value](List<T, Allocator> &list) { list.push_front(value); });
+}
+
+template <typename T, typename Allocator>
+bool FlatCombiningList<T, Allocator>::try_pop_front(T &out) {
+    bool result = false;
+    apply([&out, &result](List<T, Allocator> &list) {
+        if (list.size() > 0) {
+            out = *list.begin();
+            list.pop_front();
+            result = true;
+        }
+    });
+    return result;
+}
+
+template <typename T, typename Allocator>
+bool FlatCombiningList<T, Allocator>::try_pop_back(T &out) {
+    bool result = false;
+    apply([&out, &result](List<T, Allocator> &list) {
+        if (list.size() > 0) {
+            out = *list.rbegin();
+            list.pop_back();
+            result = true;
+        }
+    });
+    return result;
+}
+
+/*
+ *  Перед первым элементом, который больше value
+ */
+template <typename T, typename Allocator>
+void FlatCombiningList<T, Allocator>::insert_sorted(const T &value) {
+    apply([&value](List<T, Allocator> &list) {
+        auto it = list.begin();
+        while (it != list.end() && !(value < *it)) {
+            ++it;
+        }
+        list.insert(it, value);
+    });
+}
+
+template <typename T, typename Allocator>
+bool FlatCombiningList<T, Allocator>::erase_first(const T &value) {
+    bool result = false;
+    apply([&value, &result](List<T, Allocator> &list) {
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (*it == value) {
+                list.erase(it);
+                result = true;
+                return;
+            }
+        }
+    });
+    return result;
+}
+
+/*
+ *  Размер на момент последней пачки
+ */
+template <typename T, typename Allocator>
+size_t FlatCombiningList<T, Allocator>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator>
+bool FlatCombiningList<T, Allocator>::empty() const {
+    return size() == 0;
+}
@@ -0,0 +1,739 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/*
+ *
+ *      ForwardList<T, Allocator>
+ *
+ *      Односвязный список: в узле только элемент и next. Для
+ * ForwardList<int> узел 16 байт против 24 у List, так что он попадает в
+ * FixedAllocator<16>, и узлов в строку кэша влезает в полтора раза
+ * больше
+ *
+ *      Интерфейс как у std::forward_list: вставка и удаление - после
+ * позиции (insert_after, erase_after, splice_after), перед первым
+ * элементом стоит before_begin(). Размер при этом хранится, как в List
+ *
+ *      Голова - не выделенный узел, а просто указатель next внутри самого
+ * листа, так что пустой лист ничего не выделяет. Диапазоны вставляются
+ * пачками узлов через allocate_bulk, если аллокатор умеет (FastAllocator
+ * умеет)
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct ForwardList {
+private:
+    struct Link_ {
+        Link_ *next = nullptr;
+    };
+
+    struct Node : Link_ {
+        T elem_;
+
+        Node() : elem_() {}
+        Node(const T &value) : elem_(value) {}
+    };
+
+public:
+    explicit ForwardList(const Allocator &alloc = Allocator());
+    ForwardList(size_t count, const T &value,
+                const Allocator &alloc = Allocator());
+    ForwardList(size_t count);
+    template <typename ForwardIt, typename = typename std::iterator_traits<
+                                      ForwardIt>::iterator_category>
+    ForwardList(ForwardIt first, ForwardIt last,
+                const Allocator &alloc = Allocator());
+    ForwardList(const ForwardList &rhs);
+    ForwardList &operator=(const ForwardList &rhs);
+    ~ForwardList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    T &front() const;
+    void push_front(const T &value);
+    void pop_front();
+
+    Allocator &get_allocator();
+
+    template <typename U>
+    class forward_iterator;
+
+    typedef forward_iterator<T> iterator;
+    typedef forward_iterator<T const> const_iterator;
+
+    iterator before_begin() const;
+    const_iterator cbefore_begin() const;
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    iterator insert_after(const_iterator, const T &);
+    template <typename ForwardIt>
+    iterator insert_after(const_iterator, ForwardIt, ForwardIt);
+
+    iterator erase_after(const_iterator);
+    iterator erase_after(const_iterator, const_iterator);
+
+    void splice_after(const_iterator, ForwardList &);
+    void splice_after(const_iterator, ForwardList &, const_iterator);
+    void splice_after(const_iterator, ForwardList &, const_iterator,
+                      const_iterator);
+
+    void merge(ForwardList &);
+    template <typename Compare>
+    void merge(ForwardList &, Compare);
+
+    void sort();
+    template <typename Compare>
+    void sort(Compare);
+
+    void reverse();
+
+private:
+    /*
+     *  Кусок листа: last->next никуда не смотрит
+     */
+    struct Chain_ {
+        Node *first;
+        Node *last;
+    };
+
+    static const size_t bulk_nodes_ = 256;
+
+    template <typename NodeAllocator>
+    static auto allocate_nodes_(NodeAllocator &, Node **, size_t, int)
+        -> decltype(std::declval<NodeAllocator &>().allocate_bulk(
+                        std::declval<Node **>(), size_t()),
+                    void());
+    template <typename NodeAllocator>
+    static void allocate_nodes_(NodeAllocator &, Node **, size_t, long);
+
+    template <typename ForwardIt>
+    Chain_ build_chain_(ForwardIt, size_t);
+    void free_chain_(Node *);
+    void link_after_(Link_ *, Chain_, size_t);
+    Chain_ detach_();
+
+    static Node *last_of_(Node *);
+
+    template <typename Compare>
+    static Chain_ merge_chains_(Chain_, Chain_, Compare &);
+    template <typename Compare>
+    static Chain_ sort_chain_(Node *&, size_t, Compare &);
+
+    void copy_(const ForwardList &);
+
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    Allocator allocator_;
+    node_allocator_type_ node_allocator_;
+    size_t size_ = 0;
+
+    // before_begin(): head_.next - первый узел
+    mutable Link_ head_;
+};
+
+template <typename T, typename Allocator>
+const size_t ForwardList<T, Allocator>::bulk_nodes_;
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator>::ForwardList(const Allocator &alloc)
+        : allocator_(std::allocator_traits<Allocator>::
+                         select_on_container_copy_construction(alloc)),
+          node_allocator_(allocator_) {}
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator>::ForwardList(size_t count, const T &value,
+                                       const Allocator &alloc)
+        : ForwardList(alloc) {
+    for (size_t i = 0; i < count; i++) {
+        push_front(value);
+    }
+}
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator>::ForwardList(size_t count)
+        : ForwardList(Allocator()) {
+    for (size_t i = 0; i < count; i++) {
+        Node *newbie = node_allocator_traits_::allocate(node_allocator_, 1);
+        try {
+            node_allocator_traits_::construct(node_allocator_, newbie);
+        } catch (...) {
+            node_allocator_traits_::deallocate(node_allocator_, newbie, 1);
+            clear();
+            throw;
+        }
+        link_after_(&head_, Chain_{newbie, newbie}, 1);
+    }
+}
+
+/*
+ *  Весь диапазон одной цепочкой, узлы выделяются пачками
+ */
+template <typename T, typename Allocator>
+template <typename ForwardIt, typename>
+ForwardList<T, Allocator>::ForwardList(ForwardIt first, ForwardIt last,
+                                       const Allocator &alloc)
+        : ForwardList(alloc) {
+    insert_after(cbefore_begin(), first, last);
+}
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator>::ForwardList(const ForwardList &rhs)
+        : ForwardList(rhs.allocator_) {
+    copy_(rhs);
+}
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator> &ForwardList<T, Allocator>::operator=(
+    const ForwardList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+
+    if (std::allocator_traits<Allocator>::
+            propagate_on_container_copy_assignment::value) {
+        allocator_ = rhs.allocator_;
+        node_allocator_ = node_allocator_type_(allocator_);
+    }
+
+    copy_(rhs);
+
+    return *this;
+}
+
+template <typename T, typename Allocator>
+ForwardList<T, Allocator>::~ForwardList() {
+    clear();
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::copy_(const ForwardList &rhs) {
+    insert_after(cbefore_begin(), rhs.cbegin(), rhs.cend());
+}
+
+template <typename T, typename Allocator>
+size_t ForwardList<T, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, typename Allocator>
+bool ForwardList<T, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::clear() {
+    free_chain_(detach_().first);
+}
+
+template <typename T, typename Allocator>
+T &ForwardList<T, Allocator>::front() const {
+    return static_cast<Node *>(head_.next)->elem_;
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::push_front(const T &value) {
+    insert_after(cbefore_begin(), value);
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::pop_front() {
+    if (size_) {
+        erase_after(cbefore_begin());
+    }
+}
+
+template <typename T, typename Allocator>
+Allocator &ForwardList<T, Allocator>::get_allocator() {
+    return allocator_;
+}
+
+/*
+ *  Если аллокатор умеет выдавать узлы пачкой, берем пачкой, иначе по
+ * одному
+ */
+template <typename T, typename Allocator>
+template <typename NodeAllocator>
+auto ForwardList<T, Allocator>::allocate_nodes_(NodeAllocator &alloc,
+                                                Node **out, size_t count, int)
+    -> decltype(std::declval<NodeAllocator &>().allocate_bulk(
+                    std::declval<Node **>(), size_t()),
+                void()) {
+    alloc.allocate_bulk(out, count);
+}
+
+template <typename T, typename Allocator>
+template <typename NodeAllocator>
+void ForwardList<T, Allocator>::allocate_nodes_(NodeAllocator &alloc,
+                                                Node **out, size_t count,
+                                                long) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = node_allocator_traits_::allocate(alloc, 1);
+    }
+}
+
+/*
+ *  count элементов начиная с first в отдельную цепочку
+ *  Если конструктор элемента бросит, все уже выделенное возвращается
+ */
+template <typename T, typename Allocator>
+template <typename ForwardIt>
+typename ForwardList<T, Allocator>::Chain_
+ForwardList<T, Allocator>::build_chain_(ForwardIt first, size_t count) {
+    Node *nodes[bulk_nodes_];
+    Chain_ chain{nullptr, nullptr};
+
+    for (size_t done = 0; done < count;) {
+        size_t take = std::min(count - done, bulk_nodes_);
+        allocate_nodes_(node_allocator_, nodes, take, 0);
+
+        for (size_t i = 0; i < take; i++, ++first) {
+            Node *node = nodes[i];
+            try {
+                node_allocator_traits_::construct(node_allocator_, node,
+                                                  *first);
+            } catch (...) {
+                for (size_t j = i; j < take; j++) {
+                    node_allocator_traits_::deallocate(node_allocator_,
+                                                       nodes[j], 1);
+                }
+                free_chain_(chain.first);
+                throw;
+            }
+
+            if (chain.last) {
+                chain.last->next = node;
+            } else {
+                chain.first = node;
+            }
+            chain.last = node;
+        }
+        done += take;
+    }
+
+    return chain;
+}
+
+/*
+ *  Разрушаем и освобождаем цепочку, которая ни к чему не привязана
+ */
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::free_chain_(Node *node) {
+    while (node) {
+        Node *next = static_cast<Node *>(node->next);
+        node_allocator_traits_::destroy(node_allocator_, node);
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        node = next;
+    }
+}
+
+/*
+ *  Вешаем готовую цепочку сразу после pos за O(1)
+ */
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::link_after_(Link_ *pos, Chain_ chain,
+                                            size_t count) {
+    if (chain.first == nullptr) {
+        return;
+    }
+
+    chain.last->next = pos->next;
+    pos->next = chain.first;
+    size_ += count;
+}
+
+/*
+ *  Забираем все узлы, лист становится пустым. last не ищем: это O(n), а
+ * нужен он не всем
+ */
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::Chain_
+ForwardList<T, Allocator>::detach_() {
+    Chain_ chain{static_cast<Node *>(head_.next), nullptr};
+    head_.next = nullptr;
+    size_ = 0;
+    return chain;
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::Node *ForwardList<T, Allocator>::last_of_(
+    Node *node) {
+    while (node && node->next) {
+        node = static_cast<Node *>(node->next);
+    }
+    return node;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+class ForwardList<T, Allocator>::forward_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename std::remove_const<U>::type;
+    using pointer = U *;
+    using reference = U &;
+
+    forward_iterator() = default;
+    forward_iterator(
+        const forward_iterator<typename std::remove_const<T>::type> &rhs);
+    forward_iterator &operator=(const forward_iterator &rhs) = default;
+
+    U &operator*() const;
+    U *operator->() const;
+
+    forward_iterator &operator++();
+    forward_iterator operator++(int);
+
+    bool operator==(const forward_iterator<U> &rhs) const;
+    bool operator!=(const forward_iterator<U> &rhs) const;
+    friend struct ForwardList<T, Allocator>;
+    friend class forward_iterator<T const>;
+
+private:
+    forward_iterator(Link_ *link);
+
+    Link_ *link_ = nullptr;
+};
+
+template <typename T, typename Allocator>
+template <typename U>
+ForwardList<T, Allocator>::forward_iterator<U>::forward_iterator(Link_ *link)
+        : link_(link) {}
+
+template <typename T, typename Allocator>
+template <typename U>
+ForwardList<T, Allocator>::forward_iterator<U>::forward_iterator(
+    const forward_iterator<typename std::remove_const<T>::type> &rhs)
+        : link_(rhs.link_) {}
+
+template <typename T, typename Allocator>
+template <typename U>
+U &ForwardList<T, Allocator>::forward_iterator<U>::operator*() const {
+    return static_cast<Node *>(link_)->elem_;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+U *ForwardList<T, Allocator>::forward_iterator<U>::operator->() const {
+    return &(static_cast<Node *>(link_)->elem_);
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename ForwardList<T, Allocator>::template forward_iterator<U> &
+ForwardList<T, Allocator>::forward_iterator<U>::operator++() {
+    link_ = link_->next;
+    return *this;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename ForwardList<T, Allocator>::template forward_iterator<U>
+ForwardList<T, Allocator>::forward_iterator<U>::operator++(int) {
+    forward_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+bool ForwardList<T, Allocator>::forward_iterator<U>::operator==(
+    const forward_iterator<U> &rhs) const {
+    return link_ == rhs.link_;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+bool ForwardList<T, Allocator>::forward_iterator<U>::operator!=(
+    const forward_iterator<U> &rhs) const {
+    return link_ != rhs.link_;
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator
+ForwardList<T, Allocator>::before_begin() const {
+    return iterator(&head_);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::const_iterator
+ForwardList<T, Allocator>::cbefore_begin() const {
+    return const_iterator(&head_);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator ForwardList<T, Allocator>::begin()
+    const {
+    return iterator(head_.next);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::const_iterator
+ForwardList<T, Allocator>::cbegin() const {
+    return const_iterator(head_.next);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator ForwardList<T, Allocator>::end()
+    const {
+    return iterator(nullptr);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::const_iterator
+ForwardList<T, Allocator>::cend() const {
+    return const_iterator(nullptr);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator
+ForwardList<T, Allocator>::insert_after(const_iterator iter, const T &value) {
+    Node *newbie = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, newbie, value);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, newbie, 1);
+        throw;
+    }
+
+    link_after_(iter.link_, Chain_{newbie, newbie}, 1);
+    return iterator(newbie);
+}
+
+/*
+ *  Вставка диапазона после iter одним куском
+ *  Возвращает итератор на последний вставленный (или iter, если пусто)
+ */
+template <typename T, typename Allocator>
+template <typename ForwardIt>
+typename ForwardList<T, Allocator>::iterator
+ForwardList<T, Allocator>::insert_after(const_iterator iter, ForwardIt first,
+                                        ForwardIt last) {
+    size_t count = std::distance(first, last);
+    if (count == 0) {
+        return iterator(iter.link_);
+    }
+
+    Chain_ chain = build_chain_(first, count);
+    link_after_(iter.link_, chain, count);
+    return iterator(chain.last);
+}
+
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator
+ForwardList<T, Allocator>::erase_after(const_iterator iter) {
+    Node *victim = static_cast<Node *>(iter.link_->next);
+    iter.link_->next = victim->next;
+
+    node_allocator_traits_::destroy(node_allocator_, victim);
+    node_allocator_traits_::deallocate(node_allocator_, victim, 1);
+    --size_;
+
+    return iterator(iter.link_->next);
+}
+
+/*
+ *  Удаляет все строго между first и last
+ */
+template <typename T, typename Allocator>
+typename ForwardList<T, Allocator>::iterator
+ForwardList<T, Allocator>::erase_after(const_iterator first,
+                                       const_iterator last) {
+    while (first.link_->next != last.link_) {
+        erase_after(first);
+    }
+    return iterator(last.link_);
+}
+
+/*
+ *  Все элементы rhs после iter. Хвост rhs ищем проходом, так что
+ * O(rhs.size())
+ *  Аллокаторы должны быть равны, как и в std::forward_list
+ */
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::splice_after(const_iterator iter,
+                                             ForwardList &rhs) {
+    if (this == &rhs || rhs.size_ == 0) {
+        return;
+    }
+
+    size_t count = rhs.size_;
+    Chain_ chain = rhs.detach_();
+    chain.last = last_of_(chain.first);
+    link_after_(iter.link_, chain, count);
+}
+
+/*
+ *  Один элемент - тот, что после from - за O(1)
+ */
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::splice_after(const_iterator iter,
+                                             ForwardList &rhs,
+                                             const_iterator from) {
+    Node *node = static_cast<Node *>(from.link_->next);
+    if (node == nullptr || iter.link_ == from.link_ || iter.link_ == node) {
+        return;
+    }
+
+    from.link_->next = node->next;
+    --rhs.size_;
+    link_after_(iter.link_, Chain_{node, node}, 1);
+}
+
+/*
+ *  Элементы строго между first и last. Их надо пересчитать, чтобы
+ * поправить размеры, так что O(длина диапазона)
+ */
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::splice_after(const_iterator iter,
+                                             ForwardList &rhs,
+                                             const_iterator first,
+                                             const_iterator last) {
+    if (first.link_->next == last.link_) {
+        return;
+    }
+
+    Chain_ chain{static_cast<Node *>(first.link_->next), nullptr};
+    size_t count = 1;
+    chain.last = chain.first;
+    while (chain.last->next != last.link_) {
+        chain.last = static_cast<Node *>(chain.last->next);
+        ++count;
+    }
+
+    first.link_->next = last.link_;
+    rhs.size_ -= count;
+    link_after_(iter.link_, chain, count);
+}
+
+/*
+ *  Сливаем две отсортированные цепочки, перевешивая next
+ *  При равенстве сначала берем из a, так что слияние устойчивое
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+typename ForwardList<T, Allocator>::Chain_
+ForwardList<T, Allocator>::merge_chains_(Chain_ a, Chain_ b, Compare &comp) {
+    if (a.first == nullptr) {
+        return b;
+    }
+    if (b.first == nullptr) {
+        return a;
+    }
+
+    Link_ head;
+    Link_ *last = &head;
+    Node *x = a.first;
+    Node *y = b.first;
+
+    while (x && y) {
+        if (comp(y->elem_, x->elem_)) {
+            last->next = y;
+            last = y;
+            y = static_cast<Node *>(y->next);
+        } else {
+            last->next = x;
+            last = x;
+            x = static_cast<Node *>(x->next);
+        }
+    }
+    last->next = x ? x : y;
+
+    return Chain_{static_cast<Node *>(head.next), x ? a.last : b.last};
+}
+
+/*
+ *  Как в List: сверху вниз, cursor откусывает по одному узлу, так что
+ * середину не ищем
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+typename ForwardList<T, Allocator>::Chain_
+ForwardList<T, Allocator>::sort_chain_(Node *&cursor, size_t count,
+                                       Compare &comp) {
+    if (count == 0) {
+        return Chain_{nullptr, nullptr};
+    }
+
+    if (count == 1) {
+        Node *node = cursor;
+        cursor = static_cast<Node *>(cursor->next);
+        node->next = nullptr;
+        return Chain_{node, node};
+    }
+
+    Chain_ left = sort_chain_(cursor, count / 2, comp);
+    Chain_ right = sort_chain_(cursor, count - count / 2, comp);
+
+    return merge_chains_(left, right, comp);
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::merge(ForwardList &rhs) {
+    merge(rhs, std::less<T>());
+}
+
+template <typename T, typename Allocator>
+template <typename Compare>
+void ForwardList<T, Allocator>::merge(ForwardList &rhs, Compare comp) {
+    if (this == &rhs) {
+        return;
+    }
+
+    size_t count = size_ + rhs.size_;
+    Chain_ a = detach_();
+    Chain_ b = rhs.detach_();
+    a.last = last_of_(a.first);
+    b.last = last_of_(b.first);
+
+    link_after_(&head_, merge_chains_(a, b, comp), count);
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::sort() {
+    sort(std::less<T>());
+}
+
+/*
+ *  Узлы только перевешиваются, итераторы остаются валидными
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+void ForwardList<T, Allocator>::sort(Compare comp) {
+    size_t count = size_;
+    Node *cursor = detach_().first;
+
+    link_after_(&head_, sort_chain_(cursor, count, comp), count);
+}
+
+template <typename T, typename Allocator>
+void ForwardList<T, Allocator>::reverse() {
+    Link_ *reversed = nullptr;
+    Link_ *node = head_.next;
+    while (node) {
+        Link_ *next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+    head_.next = reversed;
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/*
+ *
+ *      FrozenList<T, Allocator>
+ *
+ *      Замороженный лист: элементы один раз копируются из List в один
+ * непрерывный массив и дальше только читаются
+ *      По такому массиву можно ходить по индексу, а простые циклы
+ * (count, find, sum) компилятор векторизует сам
+ *
+ *      Для арифметических T можно построить префиксные суммы и отвечать
+ * на сумму на отрезке за O(1)
+ *      Суммы считаются в sum_type: для целых это int64_t/uint64_t, для
+ * вещественных long double, иначе сам T. Префикс в int8_t переполнился бы
+ * на первой же сотне элементов, а разность больших float съедает
+ * точность. Для знаковых целых все префиксные суммы должны влезать в
+ * int64_t, иначе переполнение
+ *
+ *      Когда снова нужно менять - thaw() обратно в обычный List
+ *
+ */
+
+/*
+ *  В каком типе копить суммы по элементам T
+ */
+template <typename T, bool = std::is_integral<T>::value,
+          bool = std::is_floating_point<T>::value>
+struct FrozenSum_ {
+    typedef T type;
+};
+
+template <typename T>
+struct FrozenSum_<T, true, false> {
+    typedef typename std::conditional<std::is_signed<T>::value, int64_t,
+                                      uint64_t>::type type;
+};
+
+template <typename T>
+struct FrozenSum_<T, false, true> {
+    typedef long double type;
+};
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct FrozenList {
+public:
+    typedef typename FrozenSum_<T>::type sum_type;
+
+    typedef const T *iterator;
+    typedef const T *const_iterator;
+    typedef std::reverse_iterator<const T *> reverse_iterator;
+    typedef std::reverse_iterator<const T *> const_reverse_iterator;
+
+    template <typename ListAllocator>
+    explicit FrozenList(const List<T, ListAllocator> &list,
+                        const Allocator &alloc = Allocator());
+
+    size_t size() const;
+    bool empty() const;
+
+    const T &operator[](size_t) const;
+    const T &at(size_t) const;
+    const T *data() const;
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    size_t count(const T &) const;
+    template <typename Predicate>
+    size_t count_if(Predicate) const;
+    const_iterator find(const T &) const;
+
+    void build_prefix_index();
+    bool has_prefix_index() const;
+    sum_type prefix_sum(size_t) const;
+    sum_type range_sum(size_t, size_t) const;
+
+    template <typename ListAllocator>
+    void thaw(List<T, ListAllocator> &) const;
+
+    Allocator get_allocator() const;
+
+private:
+    using sum_allocator_type_ = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<sum_type>;
+
+    std::vector<T, Allocator> elems_;
+
+    // prefix_[i] - сумма первых i элементов, пустой если индекса нет
+    std::vector<sum_type, sum_allocator_type_> prefix_;
+};
+
+template <typename T, typename Allocator>
+template <typename ListAllocator>
+FrozenList<T, Allocator>::FrozenList(const List<T, ListAllocator> &list,
+                                     const Allocator &alloc)
+        : elems_(alloc), prefix_(alloc) {
+    elems_.reserve(list.size());
+    for (auto it = list.cbegin(); it != list.cend(); ++it) {
+        elems_.push_back(*it);
+    }
+}
+
+template <typename T, typename Allocator>
+size_t FrozenList<T, Allocator>::size() const {
+    return elems_.size();
+}
+
+template <typename T, typename Allocator>
+bool FrozenList<T, Allocator>::empty() const {
+    return elems_.empty();
+}
+
+template <typename T, typename Allocator>
+const T &FrozenList<T, Allocator>::operator[](size_t index) const {
+    return elems_[index];
+}
+
+template <typename T, typename Allocator>
+const T &FrozenList<T, Allocator>::at(size_t index) const {
+    if (index >= elems_.size()) {
+        throw std::out_of_range("FrozenList::at");
+    }
+    return elems_[index];
+}
+
+template <typename T, typename Allocator>
+const T *FrozenList<T, Allocator>::data() const {
+    return elems_.data();
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_iterator
+FrozenList<T, Allocator>::begin() const {
+    return elems_.data();
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_iterator
+FrozenList<T, Allocator>::cbegin() const {
+    return elems_.data();
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_iterator
+FrozenList<T, Allocator>::end() const {
+    return elems_.data() + elems_.size();
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_iterator
+FrozenList<T, Allocator>::cend() const {
+    return elems_.data() + elems_.size();
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_reverse_iterator
+FrozenList<T, Allocator>::rbegin() const {
+    return const_reverse_iterator(end());
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_reverse_iterator
+FrozenList<T, Allocator>::crbegin() const {
+    return const_reverse_iterator(end());
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_reverse_iterator
+FrozenList<T, Allocator>::rend() const {
+    return const_reverse_iterator(begin());
+}
+
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_reverse_iterator
+FrozenList<T, Allocator>::crend() const {
+    return const_reverse_iterator(begin());
+}
+
+/*
+ *  Без ветвлений в теле цикла, чтобы компилятор мог его векторизовать
+ */
+template <typename T, typename Allocator>
+size_t FrozenList<T, Allocator>::count(const T &value) const {
+    const T *elems = elems_.data();
+    size_t size = elems_.size();
+
+    size_t result = 0;
+    for (size_t i = 0; i < size; i++) {
+        result += elems[i] == value ? 1 : 0;
+    }
+    return result;
+}
+
+template <typename T, typename Allocator>
+template <typename Predicate>
+size_t FrozenList<T, Allocator>::count_if(Predicate pred) const {
+    const T *elems = elems_.data();
+    size_t size = elems_.size();
+
+    size_t result = 0;
+    for (size_t i = 0; i < size; i++) {
+        result += pred(elems[i]) ? 1 : 0;
+    }
+    return result;
+}
+
+/*
+ *  Смотрим блоками: внутри блока цикл без раннего выхода (векторизуется),
+ * а между блоками проверяем, нашлось ли
+ */
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::const_iterator
+FrozenList<T, Allocator>::find(const T &value) const {
+    const size_t block = 64;
+    const T *elems = elems_.data();
+    size_t size = elems_.size();
+
+    size_t i = 0;
+    for (; i + block <= size; i += block) {
+        bool found = false;
+        for (size_t j = 0; j < block; j++) {
+            found |= elems[i + j] == value;
+        }
+        if (found) {
+            break;
+        }
+    }
+
+    for (; i < size; i++) {
+        if (elems[i] == value) {
+            return elems + i;
+        }
+    }
+    return end();
+}
+
+template <typename T, typename Allocator>
+void FrozenList<T, Allocator>::build_prefix_index() {
+    static_assert(std::is_arithmetic<T>::value,
+                  "prefix index needs an arithmetic type");
+
+    prefix_.resize(elems_.size() + 1);
+    prefix_[0] = sum_type();
+    for (size_t i = 0; i < elems_.size(); i++) {
+        prefix_[i + 1] = prefix_[i] + static_cast<sum_type>(elems_[i]);
+    }
+}
+
+template <typename T, typename Allocator>
+bool FrozenList<T, Allocator>::has_prefix_index() const {
+    return !prefix_.empty();
+}
+
+/*
+ *  Сумма первых count элементов, без индекса - за O(count)
+ */
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::sum_type
+FrozenList<T, Allocator>::prefix_sum(size_t count) const {
+    if (!prefix_.empty()) {
+        return prefix_[count];
+    }
+
+    sum_type result = sum_type();
+    for (size_t i = 0; i < count; i++) {
+        result += static_cast<sum_type>(elems_[i]);
+    }
+    return result;
+}
+
+/*
+ *  Сумма на [first, last)
+ */
+template <typename T, typename Allocator>
+typename FrozenList<T, Allocator>::sum_type
+FrozenList<T, Allocator>::range_sum(size_t first, size_t last) const {
+    if (!prefix_.empty()) {
+        return prefix_[last] - prefix_[first];
+    }
+
+    sum_type result = sum_type();
+    for (size_t i = first; i < last; i++) {
+        result += static_cast<sum_type>(elems_[i]);
+    }
+    return result;
+}
+
+/*
+ *  Содержимое list заменяется элементами замороженного листа
+ *  Узлы выделяются пачками через вставку диапазона
+ */
+template <typename T, typename Allocator>
+template <typename ListAllocator>
+void FrozenList<T, Allocator>::thaw(List<T, ListAllocator> &list) const {
+    list.clear();
+    list.insert(list.cend(), cbegin(), cend());
+}
+
+template <typename T, typename Allocator>
+Allocator FrozenList<T, Allocator>::get_allocator() const {
+    return elems_.get_allocator();
+}
@@ -0,0 +1,542 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/*
+ *
+ *      IndexedList<T, Allocator>
+ *
+ *      Двусвязный список, у которого все узлы лежат в одном массиве
+ * (слэбе), а ссылки - это 32-битные номера в этом массиве, а не указатели
+ *      Для List<int> узел 24 байта, здесь 12
+ *
+ *      Слэб растет как FixedAllocator: в два раза. Удаленные узлы
+ * складываются в список свободных (через тот же next) и переиспользуются
+ *
+ *      Итератор - это номер узла, поэтому при росте слэба итераторы
+ * остаются валидными (а вот указатели и ссылки на элементы - нет)
+ *
+ *      Узел 0 - сентинел, список закольцован через него
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct IndexedList {
+public:
+    typedef uint32_t index_type;
+
+    explicit IndexedList(const Allocator &alloc = Allocator());
+    IndexedList(size_t count, const T &value,
+                const Allocator &alloc = Allocator());
+    IndexedList(size_t count);
+    IndexedList(const IndexedList &rhs);
+    IndexedList &operator=(const IndexedList &rhs);
+    ~IndexedList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    size_t capacity() const;
+    void reserve(size_t);
+    void compact();
+
+    void pop_front();
+    void pop_back();
+
+    void push_front(const T &value);
+    void push_back(const T &value);
+
+    Allocator &get_allocator();
+
+    template <typename U>
+    class indexed_iterator;
+
+    typedef indexed_iterator<T> iterator;
+    typedef indexed_iterator<T const> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    iterator insert(const_iterator, const T &);
+    iterator erase(const_iterator);
+
+private:
+    // prev == free_mark_ у узлов в списке свободных
+    static const index_type free_mark_ = static_cast<index_type>(-1);
+    static const index_type sentinel_ = 0;
+
+    struct Node {
+        index_type next;
+        index_type prev;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type elem_;
+
+        T *elem() { return reinterpret_cast<T *>(&elem_); }
+    };
+
+    using allocator_traits_ = std::allocator_traits<Allocator>;
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    index_type acquire_();
+    void release_(index_type);
+    void grow_(size_t);
+
+    void copy_(const IndexedList &);
+
+    Allocator allocator_;
+    node_allocator_type_ node_allocator_;
+    size_t size_ = 0;
+
+    Node *slab_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;  // сколько узлов слэба хоть раз выдавалось
+    index_type free_ = free_mark_;
+};
+
+template <typename T, typename Allocator>
+const typename IndexedList<T, Allocator>::index_type
+    IndexedList<T, Allocator>::free_mark_;
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator>::IndexedList(const Allocator &alloc)
+        : allocator_(std::allocator_traits<Allocator>::
+                         select_on_container_copy_construction(alloc)) {
+    grow_(32);
+
+    used_ = 1;
+    slab_[sentinel_].next = slab_[sentinel_].prev = sentinel_;
+}
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator>::IndexedList(size_t count, const T &value,
+                                       const Allocator &alloc)
+        : IndexedList(alloc) {
+    reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        push_back(value);
+    }
+}
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator>::IndexedList(size_t count)
+        : IndexedList(Allocator()) {
+    reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        push_back(T());
+    }
+}
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator>::IndexedList(const IndexedList &rhs)
+        : IndexedList(rhs.allocator_) {
+    copy_(rhs);
+}
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator> &IndexedList<T, Allocator>::operator=(
+    const IndexedList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+
+    if (std::allocator_traits<Allocator>::
+            propagate_on_container_copy_assignment::value) {
+        allocator_ = rhs.allocator_;
+    }
+
+    copy_(rhs);
+
+    return *this;
+}
+
+template <typename T, typename Allocator>
+IndexedList<T, Allocator>::~IndexedList() {
+    clear();
+    node_allocator_traits_::deallocate(node_allocator_, slab_, capacity_);
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::copy_(const IndexedList &rhs) {
+    reserve(rhs.size_);
+    for (auto it = rhs.cbegin(); it != rhs.cend(); ++it) {
+        push_back(*it);
+    }
+}
+
+/*
+ *  Новый слэб, живые элементы в него переносим на те же номера
+ */
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::grow_(size_t capacity) {
+    if (capacity > static_cast<size_t>(free_mark_)) {
+        throw std::length_error("IndexedList is limited to 2^32 - 1 nodes");
+    }
+
+    Node *slab = node_allocator_traits_::allocate(node_allocator_, capacity);
+
+    for (size_t i = 0; i < used_; i++) {
+        slab[i].next = slab_[i].next;
+        slab[i].prev = slab_[i].prev;
+        if (i != sentinel_ && slab_[i].prev != free_mark_) {
+            allocator_traits_::construct(allocator_, slab[i].elem(),
+                                         std::move(*slab_[i].elem()));
+            allocator_traits_::destroy(allocator_, slab_[i].elem());
+        }
+    }
+
+    if (slab_) {
+        node_allocator_traits_::deallocate(node_allocator_, slab_, capacity_);
+    }
+
+    slab_ = slab;
+    capacity_ = capacity;
+}
+
+/*
+ *  Свободный узел: сначала из списка свободных, потом с конца слэба
+ */
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::index_type
+IndexedList<T, Allocator>::acquire_() {
+    if (free_ != free_mark_) {
+        index_type index = free_;
+        free_ = slab_[index].next;
+        return index;
+    }
+
+    if (used_ == capacity_) {
+        size_t capacity = capacity_ * 2;
+        if (capacity > static_cast<size_t>(free_mark_)) {
+            capacity = static_cast<size_t>(free_mark_);
+        }
+        if (capacity == capacity_) {
+            throw std::length_error("IndexedList is limited to 2^32 - 1 nodes");
+        }
+        grow_(capacity);
+    }
+
+    return static_cast<index_type>(used_++);
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::release_(index_type index) {
+    slab_[index].prev = free_mark_;
+    slab_[index].next = free_;
+    free_ = index;
+}
+
+template <typename T, typename Allocator>
+size_t IndexedList<T, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, typename Allocator>
+bool IndexedList<T, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, typename Allocator>
+size_t IndexedList<T, Allocator>::capacity() const {
+    return capacity_ - 1;
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::reserve(size_t count) {
+    if (count + 1 > capacity_) {
+        grow_(count + 1);
+    }
+}
+
+/*
+ *  Все узлы уже выдавались, так что список свободных просто сбрасываем
+ */
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::clear() {
+    for (index_type i = slab_[sentinel_].next; i != sentinel_;
+         i = slab_[i].next) {
+        allocator_traits_::destroy(allocator_, slab_[i].elem());
+    }
+
+    slab_[sentinel_].next = slab_[sentinel_].prev = sentinel_;
+    used_ = 1;
+    free_ = free_mark_;
+    size_ = 0;
+}
+
+/*
+ *  Перенумеровываем узлы в порядке списка: после этого элемент номер k
+ * лежит в узле k + 1, обход идет по памяти подряд, а свободных дыр нет
+ *  Итераторы после compact() недействительны
+ */
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::compact() {
+    Node *slab = node_allocator_traits_::allocate(node_allocator_, capacity_);
+
+    index_type position = 1;
+    for (index_type i = slab_[sentinel_].next; i != sentinel_;
+         i = slab_[i].next, position++) {
+        allocator_traits_::construct(allocator_, slab[position].elem(),
+                                     std::move(*slab_[i].elem()));
+        allocator_traits_::destroy(allocator_, slab_[i].elem());
+
+        slab[position].prev = position - 1;
+        slab[position].next = position + 1;
+    }
+
+    index_type last = position - 1;
+    slab[last].next = sentinel_;
+    slab[sentinel_].prev = last;
+    slab[sentinel_].next = size_ ? 1 : sentinel_;
+
+    node_allocator_traits_::deallocate(node_allocator_, slab_, capacity_);
+
+    slab_ = slab;
+    used_ = position;
+    free_ = free_mark_;
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::pop_front() {
+    if (size_) {
+        erase(begin());
+    }
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::pop_back() {
+    if (size_) {
+        erase(--end());
+    }
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::push_front(const T &value) {
+    insert(begin(), value);
+}
+
+template <typename T, typename Allocator>
+void IndexedList<T, Allocator>::push_back(const T &value) {
+    insert(end(), value);
+}
+
+template <typename T, typename Allocator>
+Allocator &IndexedList<T, Allocator>::get_allocator() {
+    return allocator_;
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::iterator IndexedList<T, Allocator>::insert(
+    const_iterator iter, const T &value) {
+    index_type newbie;
+    if (free_ == free_mark_ && used_ == capacity_) {
+        // value может лежать в слэбе, который сейчас переедет
+        T copy(value);
+        newbie = acquire_();
+        allocator_traits_::construct(allocator_, slab_[newbie].elem(),
+                                     std::move(copy));
+    } else {
+        newbie = acquire_();
+        allocator_traits_::construct(allocator_, slab_[newbie].elem(), value);
+    }
+
+    index_type next = iter.index_;
+    index_type prev = slab_[next].prev;
+
+    slab_[newbie].next = next;
+    slab_[newbie].prev = prev;
+    slab_[prev].next = newbie;
+    slab_[next].prev = newbie;
+
+    ++size_;
+    return iterator(this, newbie);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::iterator IndexedList<T, Allocator>::erase(
+    const_iterator iter) {
+    index_type index = iter.index_;
+    index_type next = slab_[index].next;
+    index_type prev = slab_[index].prev;
+
+    slab_[prev].next = next;
+    slab_[next].prev = prev;
+
+    allocator_traits_::destroy(allocator_, slab_[index].elem());
+    release_(index);
+
+    --size_;
+    return iterator(this, next);
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+class IndexedList<T, Allocator>::indexed_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename std::remove_const<U>::type;
+    using pointer = U *;
+    using reference = U &;
+
+    indexed_iterator() = default;
+    indexed_iterator(const indexed_iterator<typename std::remove_const<T>::type> &rhs);
+    indexed_iterator &operator=(const indexed_iterator &rhs) = default;
+
+    U &operator*() const;
+    U *operator->() const;
+
+    indexed_iterator &operator++();
+    indexed_iterator operator++(int);
+    indexed_iterator &operator--();
+    indexed_iterator operator--(int);
+
+    bool operator==(const indexed_iterator<U> &rhs) const;
+    bool operator!=(const indexed_iterator<U> &rhs) const;
+    friend struct IndexedList<T, Allocator>;
+    friend class indexed_iterator<T const>;
+
+private:
+    indexed_iterator(const IndexedList *list, index_type index);
+
+    const IndexedList *list_ = nullptr;
+    index_type index_ = 0;
+};
+
+template <typename T, typename Allocator>
+template <typename U>
+IndexedList<T, Allocator>::indexed_iterator<U>::indexed_iterator(
+    const IndexedList *list, index_type index)
+        : list_(list), index_(index) {}
+
+template <typename T, typename Allocator>
+template <typename U>
+IndexedList<T, Allocator>::indexed_iterator<U>::indexed_iterator(
+    const indexed_iterator<typename std::remove_const<T>::type> &rhs)
+        : list_(rhs.list_), index_(rhs.index_) {}
+
+template <typename T, typename Allocator>
+template <typename U>
+U &IndexedList<T, Allocator>::indexed_iterator<U>::operator*() const {
+    return *list_->slab_[index_].elem();
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+U *IndexedList<T, Allocator>::indexed_iterator<U>::operator->() const {
+    return list_->slab_[index_].elem();
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename IndexedList<T, Allocator>::template indexed_iterator<U> &
+IndexedList<T, Allocator>::indexed_iterator<U>::operator++() {
+    index_ = list_->slab_[index_].next;
+    return *this;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename IndexedList<T, Allocator>::template indexed_iterator<U>
+IndexedList<T, Allocator>::indexed_iterator<U>::operator++(int) {
+    indexed_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename IndexedList<T, Allocator>::template indexed_iterator<U> &
+IndexedList<T, Allocator>::indexed_iterator<U>::operator--() {
+    index_ = list_->slab_[index_].prev;
+    return *this;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+typename IndexedList<T, Allocator>::template indexed_iterator<U>
+IndexedList<T, Allocator>::indexed_iterator<U>::operator--(int) {
+    indexed_iterator other = *this;
+    --(*this);
+    return other;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+bool IndexedList<T, Allocator>::indexed_iterator<U>::operator==(
+    const indexed_iterator<U> &rhs) const {
+    return index_ == rhs.index_ && list_ == rhs.list_;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+bool IndexedList<T, Allocator>::indexed_iterator<U>::operator!=(
+    const indexed_iterator<U> &rhs) const {
+    return !(*this == rhs);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::iterator
+IndexedList<T, Allocator>::begin() const {
+    return iterator(this, slab_[sentinel_].next);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::const_iterator
+IndexedList<T, Allocator>::cbegin() const {
+    return const_iterator(this, slab_[sentinel_].next);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::iterator
+IndexedList<T, Allocator>::end() const {
+    return iterator(this, sentinel_);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::const_iterator
+IndexedList<T, Allocator>::cend() const {
+    return const_iterator(this, sentinel_);
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::reverse_iterator
+IndexedList<T, Allocator>::rbegin() const {
+    return reverse_iterator(end());
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::const_reverse_iterator
+IndexedList<T, Allocator>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::reverse_iterator
+IndexedList<T, Allocator>::rend() const {
+    return reverse_iterator(begin());
+}
+
+template <typename T, typename Allocator>
+typename IndexedList<T, Allocator>::const_reverse_iterator
+IndexedList<T, Allocator>::crend() const {
+    return const_reverse_iterator(cbegin());
+}
@@ -0,0 +1,427 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+/*
+ *
+ *      IntrusiveList<T, Hook>
+ *
+ *      Интрузивный двусвязный список: указатели next/prev (ListHook) лежат
+ * прямо внутри объекта, а список только связывает уже существующие
+ * объекты. Никаких узлов и никаких аллокаций - объекты могут жить где
+ * угодно: в пуле, в арене, в блоках FixedAllocator
+ *
+ *      Хук можно подключить двумя способами:
+ *      - базовым классом: struct A : ListBaseHook<> {...},
+ *        IntrusiveList<A> (или ListBaseHook<Tag> и BaseHook<A, Tag>)
+ *      - полем: struct A { ListHook hook; ... },
+ *        IntrusiveList<A, MemberHook<A, &A::hook>>
+ *      Если хуков несколько (разные поля или разные Tag), объект может
+ * одновременно лежать в нескольких списках
+ *
+ *      Список не владеет объектами: деструктор и clear() только
+ * отцепляют их. Объект нельзя разрушать, пока он в списке
+ *
+ */
+
+struct ListHook {
+    ListHook *next = nullptr;
+    ListHook *prev = nullptr;
+
+    ListHook() = default;
+
+    // копия объекта не попадает в списки оригинала
+    ListHook(const ListHook &) {}
+    ListHook &operator=(const ListHook &) { return *this; }
+
+    bool is_linked() const { return next != nullptr; }
+};
+
+template <typename Tag = void>
+struct ListBaseHook : ListHook {};
+
+/*
+ *  Как из объекта получить хук и обратно
+ */
+template <typename T, typename Tag = void>
+struct BaseHook {
+    static ListHook *to_hook(T *value) {
+        return static_cast<ListBaseHook<Tag> *>(value);
+    }
+    static T *to_value(ListHook *hook) {
+        return static_cast<T *>(static_cast<ListBaseHook<Tag> *>(hook));
+    }
+};
+
+template <typename T, ListHook T::*Member>
+struct MemberHook {
+    static ListHook *to_hook(T *value) {
+        return &(value->*Member);
+    }
+    static T *to_value(ListHook *hook) {
+        return reinterpret_cast<T *>(reinterpret_cast<char *>(hook) - offset_());
+    }
+
+private:
+    static ptrdiff_t offset_() {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        T *fake = reinterpret_cast<T *>(&storage);
+        return reinterpret_cast<char *>(&(fake->*Member)) -
+               reinterpret_cast<char *>(fake);
+    }
+};
+
+template <typename T, typename Hook = BaseHook<T> >
+struct IntrusiveList {
+public:
+    IntrusiveList();
+    IntrusiveList(const IntrusiveList &) = delete;
+    IntrusiveList &operator=(const IntrusiveList &) = delete;
+    ~IntrusiveList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    T &front() const;
+    T &back() const;
+
+    void pop_front();
+    void pop_back();
+
+    void push_front(T &value);
+    void push_back(T &value);
+
+    template <typename U>
+    class intrusive_iterator;
+
+    typedef intrusive_iterator<T> iterator;
+    typedef intrusive_iterator<T const> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    iterator insert(const_iterator, T &);
+    iterator erase(const_iterator);
+    iterator erase(T &);
+
+    iterator iterator_to(T &) const;
+
+    void splice(const_iterator, IntrusiveList &);
+
+private:
+    void link_before_(ListHook *, ListHook *);
+    void unlink_(ListHook *);
+
+    // сентинел, список закольцован через него
+    mutable ListHook head_;
+    size_t size_ = 0;
+};
+
+template <typename T, typename Hook>
+IntrusiveList<T, Hook>::IntrusiveList() {
+    head_.next = head_.prev = &head_;
+}
+
+template <typename T, typename Hook>
+IntrusiveList<T, Hook>::~IntrusiveList() {
+    clear();
+}
+
+template <typename T, typename Hook>
+size_t IntrusiveList<T, Hook>::size() const {
+    return size_;
+}
+
+template <typename T, typename Hook>
+bool IntrusiveList<T, Hook>::empty() const {
+    return size_ == 0;
+}
+
+/*
+ *  Объекты остаются жить, только перестают быть в списке
+ */
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::clear() {
+    ListHook *hook = head_.next;
+    while (hook != &head_) {
+        ListHook *next = hook->next;
+        hook->next = hook->prev = nullptr;
+        hook = next;
+    }
+
+    head_.next = head_.prev = &head_;
+    size_ = 0;
+}
+
+template <typename T, typename Hook>
+T &IntrusiveList<T, Hook>::front() const {
+    return *Hook::to_value(head_.next);
+}
+
+template <typename T, typename Hook>
+T &IntrusiveList<T, Hook>::back() const {
+    return *Hook::to_value(head_.prev);
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::pop_front() {
+    if (size_) {
+        unlink_(head_.next);
+    }
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::pop_back() {
+    if (size_) {
+        unlink_(head_.prev);
+    }
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::push_front(T &value) {
+    link_before_(head_.next, Hook::to_hook(&value));
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::push_back(T &value) {
+    link_before_(&head_, Hook::to_hook(&value));
+}
+
+/*
+ *  Хук уже в каком-то списке - перезапись next/prev молча порвала бы тот
+ * список, поэтому сначала erase
+ */
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::link_before_(ListHook *ptr, ListHook *hook) {
+    assert(!hook->is_linked());
+
+    hook->next = ptr;
+    hook->prev = ptr->prev;
+    ptr->prev->next = hook;
+    ptr->prev = hook;
+    ++size_;
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::unlink_(ListHook *hook) {
+    hook->prev->next = hook->next;
+    hook->next->prev = hook->prev;
+    hook->next = hook->prev = nullptr;
+    --size_;
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::insert(
+    const_iterator iter, T &value) {
+    ListHook *hook = Hook::to_hook(&value);
+    link_before_(iter.hook_, hook);
+    return iterator(hook);
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::erase(
+    const_iterator iter) {
+    iterator ret(iter.hook_->next);
+    unlink_(iter.hook_);
+    return ret;
+}
+
+/*
+ *  Отцепить объект, зная только его самого, за O(1)
+ */
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::erase(
+    T &value) {
+    return erase(const_iterator(Hook::to_hook(&value)));
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::iterator_to(
+    T &value) const {
+    return iterator(Hook::to_hook(&value));
+}
+
+template <typename T, typename Hook>
+void IntrusiveList<T, Hook>::splice(const_iterator iter, IntrusiveList &rhs) {
+    if (this == &rhs || rhs.size_ == 0) {
+        return;
+    }
+
+    ListHook *first = rhs.head_.next;
+    ListHook *last = rhs.head_.prev;
+    ListHook *ptr = iter.hook_;
+
+    first->prev = ptr->prev;
+    last->next = ptr;
+    ptr->prev->next = first;
+    ptr->prev = last;
+
+    size_ += rhs.size_;
+    rhs.head_.next = rhs.head_.prev = &rhs.head_;
+    rhs.size_ = 0;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+class IntrusiveList<T, Hook>::intrusive_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename std::remove_const<U>::type;
+    using pointer = U *;
+    using reference = U &;
+
+    intrusive_iterator() = default;
+    intrusive_iterator(const intrusive_iterator<typename std::remove_const<T>::type> &rhs);
+    intrusive_iterator &operator=(const intrusive_iterator &rhs) = default;
+
+    U &operator*() const;
+    U *operator->() const;
+
+    intrusive_iterator &operator++();
+    intrusive_iterator operator++(int);
+    intrusive_iterator &operator--();
+    intrusive_iterator operator--(int);
+
+    bool operator==(const intrusive_iterator<U> &rhs) const;
+    bool operator!=(const intrusive_iterator<U> &rhs) const;
+    friend struct IntrusiveList<T, Hook>;
+    friend class intrusive_iterator<T const>;
+
+private:
+    explicit intrusive_iterator(ListHook *hook);
+
+    ListHook *hook_ = nullptr;
+};
+
+template <typename T, typename Hook>
+template <typename U>
+IntrusiveList<T, Hook>::intrusive_iterator<U>::intrusive_iterator(
+    ListHook *hook)
+        : hook_(hook) {}
+
+template <typename T, typename Hook>
+template <typename U>
+IntrusiveList<T, Hook>::intrusive_iterator<U>::intrusive_iterator(
+    const intrusive_iterator<typename std::remove_const<T>::type> &rhs)
+        : hook_(rhs.hook_) {}
+
+template <typename T, typename Hook>
+template <typename U>
+U &IntrusiveList<T, Hook>::intrusive_iterator<U>::operator*() const {
+    return *Hook::to_value(hook_);
+}
+
+template <typename T, typename Hook>
+template <typename U>
+U *IntrusiveList<T, Hook>::intrusive_iterator<U>::operator->() const {
+    return Hook::to_value(hook_);
+}
+
+template <typename T, typename Hook>
+template <typename U>
+typename IntrusiveList<T, Hook>::template intrusive_iterator<U> &
+IntrusiveList<T, Hook>::intrusive_iterator<U>::operator++() {
+    hook_ = hook_->next;
+    return *this;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+typename IntrusiveList<T, Hook>::template intrusive_iterator<U>
+IntrusiveList<T, Hook>::intrusive_iterator<U>::operator++(int) {
+    intrusive_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+typename IntrusiveList<T, Hook>::template intrusive_iterator<U> &
+IntrusiveList<T, Hook>::intrusive_iterator<U>::operator--() {
+    hook_ = hook_->prev;
+    return *this;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+typename IntrusiveList<T, Hook>::template intrusive_iterator<U>
+IntrusiveList<T, Hook>::intrusive_iterator<U>::operator--(int) {
+    intrusive_iterator other = *this;
+    --(*this);
+    return other;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+bool IntrusiveList<T, Hook>::intrusive_iterator<U>::operator==(
+    const intrusive_iterator<U> &rhs) const {
+    return hook_ == rhs.hook_;
+}
+
+template <typename T, typename Hook>
+template <typename U>
+bool IntrusiveList<T, Hook>::intrusive_iterator<U>::operator!=(
+    const intrusive_iterator<U> &rhs) const {
+    return hook_ != rhs.hook_;
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator
+IntrusiveList<T, Hook>::begin() const {
+    return iterator(head_.next);
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::const_iterator
+IntrusiveList<T, Hook>::cbegin() const {
+    return const_iterator(head_.next);
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::end() const {
+    return iterator(&head_);
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::const_iterator
+IntrusiveList<T, Hook>::cend() const {
+    return const_iterator(&head_);
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::reverse_iterator
+IntrusiveList<T, Hook>::rbegin() const {
+    return reverse_iterator(end());
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator
+IntrusiveList<T, Hook>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::reverse_iterator
+IntrusiveList<T, Hook>::rend() const {
+    return reverse_iterator(begin());
+}
+
+template <typename T, typename Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator
+IntrusiveList<T, Hook>::crend() const {
+    return const_reverse_iterator(cbegin());
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+/*
+ *
+ *      Сохранение и загрузка List в бинарный поток
+ *
+ *      Формат:
+ *      - заголовок ListStreamHeader (магия, версия, флаги, размер элемента,
+ * количество элементов)
+ *      - элементы подряд
+ *
+ *      Для тривиально копируемых T элементы лежат как есть, байт в байт, и
+ * читаются/пишутся большими буферами. Для остальных T вызываются
+ * save_element/load_element, их можно перегрузить для своего типа (ищутся
+ * через ADL), для std::string перегрузка уже есть
+ *
+ *      Ошибки - как у обычных потоков: если формат не тот, выставляем
+ * failbit и выходим
+ *
+ */
+
+struct ListStreamHeader {
+    static const uint32_t magic = 0x3154534c;  // "LST1"
+    static const uint32_t version = 1;
+
+    static const uint32_t raw_elements = 1;  // элементы лежат байт в байт
+
+    uint32_t magic_;
+    uint32_t version_;
+    uint32_t flags_;
+    uint32_t element_size_;
+    uint64_t count_;
+};
+
+/*
+ *  Размер буфера для пакетного чтения/записи
+ */
+static const size_t list_stream_buffer_size = 1 << 20;
+
+template <typename T>
+void save_element(std::ostream &out, const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "save_element must be overloaded for this type");
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void load_element(std::istream &in, T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "load_element must be overloaded for this type");
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+template <typename Char, typename Traits, typename Alloc>
+void save_element(std::ostream &out,
+                  const std::basic_string<Char, Traits, Alloc> &value) {
+    uint64_t length = value.size();
+    out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.write(reinterpret_cast<const char *>(value.data()),
+              length * sizeof(Char));
+}
+
+template <typename Char, typename Traits, typename Alloc>
+void load_element(std::istream &in,
+                  std::basic_string<Char, Traits, Alloc> &value) {
+    uint64_t length = 0;
+    if (!in.read(reinterpret_cast<char *>(&length), sizeof(length))) {
+        return;
+    }
+    value.resize(length);
+    in.read(reinterpret_cast<char *>(&value[0]), length * sizeof(Char));
+}
+
+/*
+ *  Пишем по буферу: копируем элементы из узлов подряд в буфер, потом
+ * один write на мегабайт, а не на каждый элемент
+ */
+template <typename T, typename Allocator>
+void save_list_elements_(std::ostream &out, const List<T, Allocator> &list,
+                         std::true_type) {
+    const size_t per_buffer = list_stream_buffer_size / sizeof(T) + 1;
+    std::vector<char> buffer(per_buffer * sizeof(T));
+
+    auto it = list.cbegin();
+    for (size_t done = 0; done < list.size() && out;) {
+        size_t take = std::min(list.size() - done, per_buffer);
+        char *position = buffer.data();
+        for (size_t i = 0; i < take; i++, ++it) {
+            std::memcpy(position, &*it, sizeof(T));
+            position += sizeof(T);
+        }
+        out.write(buffer.data(), take * sizeof(T));
+        done += take;
+    }
+}
+
+template <typename T, typename Allocator>
+void save_list_elements_(std::ostream &out, const List<T, Allocator> &list,
+                         std::false_type) {
+    for (auto it = list.cbegin(); it != list.cend() && out; ++it) {
+        save_element(out, *it);
+    }
+}
+
+/*
+ *  Читаем по буферу и вешаем весь буфер в лист одной вставкой диапазона,
+ * а она выделяет узлы пачками
+ */
+template <typename T, typename Allocator>
+void load_list_elements_(std::istream &in, List<T, Allocator> &list,
+                         uint64_t count, std::true_type) {
+    using storage_type =
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    const size_t per_buffer = list_stream_buffer_size / sizeof(T) + 1;
+    std::vector<storage_type> buffer(
+        std::min<uint64_t>(count, per_buffer));
+
+    for (uint64_t done = 0; done < count;) {
+        size_t take = std::min<uint64_t>(count - done, buffer.size());
+        if (!in.read(reinterpret_cast<char *>(buffer.data()), take * sizeof(T))) {
+            return;
+        }
+
+        const T *first = reinterpret_cast<const T *>(buffer.data());
+        list.insert(list.cend(), first, first + take);
+        done += take;
+    }
+}
+
+template <typename T, typename Allocator>
+void load_list_elements_(std::istream &in, List<T, Allocator> &list,
+                         uint64_t count, std::false_type) {
+    for (uint64_t i = 0; i < count; i++) {
+        T value;
+        load_element(in, value);
+        if (!in) {
+            return;
+        }
+        list.push_back(value);
+    }
+}
+
+template <typename T, typename Allocator>
+std::ostream &save_list(std::ostream &out, const List<T, Allocator> &list) {
+    using raw = std::is_trivially_copyable<T>;
+
+    ListStreamHeader header;
+    header.magic_ = ListStreamHeader::magic;
+    header.version_ = ListStreamHeader::version;
+    header.flags_ = raw::value ? ListStreamHeader::raw_elements : 0;
+    header.element_size_ = sizeof(T);
+    header.count_ = list.size();
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    save_list_elements_(out, list, raw());
+
+    return out;
+}
+
+/*
+ *  Содержимое list заменяется содержимым потока
+ *  Если поток оборвался посередине, в листе останется то, что успели
+ * прочитать, и у потока будет выставлен failbit
+ */
+template <typename T, typename Allocator>
+std::istream &load_list(std::istream &in, List<T, Allocator> &list) {
+    using raw = std::is_trivially_copyable<T>;
+
+    ListStreamHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return in;
+    }
+
+    bool header_raw = (header.flags_ & ListStreamHeader::raw_elements) != 0;
+    if (header.magic_ != ListStreamHeader::magic ||
+        header.version_ > ListStreamHeader::version ||
+        header.element_size_ != sizeof(T) || header_raw != raw::value) {
+        in.setstate(std::ios::failbit);
+        return in;
+    }
+
+    list.clear();
+    load_list_elements_(in, list, header.count_, raw());
+
+    return in;
+}
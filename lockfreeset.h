@@ -0,0 +1,276 @@
+#pragma once
+
+#include "concurrentallocator.h"
+#include "epochdomain.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+/*
+ *
+ *      LockFreeSet<T, Compare, Allocator>
+ *
+ *      Упорядоченное множество на односвязном списке без блокировок
+ * (алгоритм Harris-Michael)
+ *
+ *      Удаление в два шага: сначала помечаем младший бит указателя next у
+ * удаляемого узла (логическое удаление, после этого за ним ничего не
+ * вставить), потом CAS-ом выкидываем узел из списка. Если второй шаг не
+ * удался, узел выкинет следующий, кто будет проходить мимо
+ *
+ *      Выкинутые узлы освобождаются через EpochDomain::retire, когда их
+ * уже никто не может видеть. Все операции идут внутри EpochGuard
+ *
+ *      contains не делает ни одной записи в общую память, кроме слота
+ * эпохи
+ *
+ *      Узлы освобождаются в чужих потоках и без объекта множества, поэтому
+ * аллокатор должен быть потокобезопасным и без состояния (по умолчанию
+ * ConcurrentFastAllocator)
+ *
+ */
+
+template <typename T, typename Compare = std::less<T>,
+          typename Allocator = ConcurrentFastAllocator<T> >
+struct LockFreeSet {
+private:
+    struct Node {
+        std::atomic<uintptr_t> next;
+        T elem_;
+
+        explicit Node(const T &elem) : next(0), elem_(elem) {}
+    };
+
+public:
+    explicit LockFreeSet(const Compare &comp = Compare(),
+                         const Allocator &alloc = Allocator());
+    ~LockFreeSet();
+
+    LockFreeSet(const LockFreeSet &) = delete;
+    LockFreeSet &operator=(const LockFreeSet &) = delete;
+
+    bool insert(const T &value);
+    bool erase(const T &value);
+    bool contains(const T &value) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    template <typename Function>
+    void for_each(Function f) const;
+
+    Allocator get_allocator() const;
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    static const uintptr_t mark_ = 1;
+
+    static Node *pointer_(uintptr_t link);
+    static void free_node_(void *);
+
+    bool find_(const T &value, std::atomic<uintptr_t> *&prev, Node *&curr);
+
+    Compare comp_;
+    node_allocator_type_ node_allocator_;
+
+    std::atomic<uintptr_t> head_{0};
+    std::atomic<size_t> size_{0};
+};
+
+template <typename T, typename Compare, typename Allocator>
+LockFreeSet<T, Compare, Allocator>::LockFreeSet(const Compare &comp,
+                                                const Allocator &alloc)
+        : comp_(comp), node_allocator_(alloc) {}
+
+/*
+ *  Других потоков к этому моменту быть не должно
+ */
+template <typename T, typename Compare, typename Allocator>
+LockFreeSet<T, Compare, Allocator>::~LockFreeSet() {
+    Node *node = pointer_(head_.load(std::memory_order_relaxed));
+    while (node) {
+        Node *next = pointer_(node->next.load(std::memory_order_relaxed));
+        free_node_(node);
+        node = next;
+    }
+}
+
+template <typename T, typename Compare, typename Allocator>
+typename LockFreeSet<T, Compare, Allocator>::Node *
+LockFreeSet<T, Compare, Allocator>::pointer_(uintptr_t link) {
+    return reinterpret_cast<Node *>(link & ~mark_);
+}
+
+template <typename T, typename Compare, typename Allocator>
+void LockFreeSet<T, Compare, Allocator>::free_node_(void *ptr) {
+    node_allocator_type_ alloc;
+    Node *node = static_cast<Node *>(ptr);
+    node_allocator_traits_::destroy(alloc, node);
+    node_allocator_traits_::deallocate(alloc, node, 1);
+}
+
+/*
+ *  Ищем первый узел не меньше value. prev - ссылка, которая на него
+ * указывает
+ *  По дороге выкидываем помеченные узлы. Если CAS не прошел (prev сам
+ * помечен или поменялся), начинаем сначала
+ */
+template <typename T, typename Compare, typename Allocator>
+bool LockFreeSet<T, Compare, Allocator>::find_(const T &value,
+                                               std::atomic<uintptr_t> *&prev,
+                                               Node *&curr) {
+retry:
+    prev = &head_;
+    curr = pointer_(prev->load(std::memory_order_acquire));
+
+    while (curr) {
+        uintptr_t next = curr->next.load(std::memory_order_acquire);
+
+        if (next & mark_) {
+            uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+            if (!prev->compare_exchange_strong(expected, next & ~mark_,
+                                               std::memory_order_acq_rel)) {
+                goto retry;
+            }
+            EpochDomain::getEpochDomain()->retire(curr, &free_node_);
+            curr = pointer_(next);
+            continue;
+        }
+
+        if (!comp_(curr->elem_, value)) {
+            return !comp_(value, curr->elem_);
+        }
+
+        prev = &curr->next;
+        curr = pointer_(next);
+    }
+    return false;
+}
+
+template <typename T, typename Compare, typename Allocator>
+bool LockFreeSet<T, Compare, Allocator>::insert(const T &value) {
+    EpochGuard guard;
+
+    Node *node = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, node, value);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        throw;
+    }
+
+    std::atomic<uintptr_t> *prev;
+    Node *curr;
+    while (true) {
+        if (find_(value, prev, curr)) {
+            // узел никто не видел, можно сразу
+            free_node_(node);
+            return false;
+        }
+
+        node->next.store(reinterpret_cast<uintptr_t>(curr),
+                         std::memory_order_relaxed);
+        uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+        if (prev->compare_exchange_strong(expected,
+                                          reinterpret_cast<uintptr_t>(node),
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+/*
+ *  Удалил тот, кто поставил метку. Выкинуть узел из списка может уже
+ * кто угодно - retire зовет именно тот, у кого прошел CAS на prev
+ */
+template <typename T, typename Compare, typename Allocator>
+bool LockFreeSet<T, Compare, Allocator>::erase(const T &value) {
+    EpochGuard guard;
+
+    std::atomic<uintptr_t> *prev;
+    Node *curr;
+    while (true) {
+        if (!find_(value, prev, curr)) {
+            return false;
+        }
+
+        uintptr_t next = curr->next.load(std::memory_order_acquire);
+        if (next & mark_) {
+            continue;
+        }
+        if (!curr->next.compare_exchange_strong(next, next | mark_,
+                                                std::memory_order_acq_rel)) {
+            continue;
+        }
+        size_.fetch_sub(1, std::memory_order_relaxed);
+
+        uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+        if (prev->compare_exchange_strong(expected, next,
+                                          std::memory_order_acq_rel)) {
+            EpochDomain::getEpochDomain()->retire(curr, &free_node_);
+        } else {
+            find_(value, prev, curr);
+        }
+        return true;
+    }
+}
+
+/*
+ *  Просто идем по списку, ничего не выкидывая
+ */
+template <typename T, typename Compare, typename Allocator>
+bool LockFreeSet<T, Compare, Allocator>::contains(const T &value) const {
+    EpochGuard guard;
+
+    Node *curr = pointer_(head_.load(std::memory_order_acquire));
+    while (curr && comp_(curr->elem_, value)) {
+        curr = pointer_(curr->next.load(std::memory_order_acquire));
+    }
+
+    return curr && !comp_(value, curr->elem_) &&
+           !(curr->next.load(std::memory_order_acquire) & mark_);
+}
+
+/*
+ *  Примерный размер: между операциями он точный, во время - как получится
+ */
+template <typename T, typename Compare, typename Allocator>
+size_t LockFreeSet<T, Compare, Allocator>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Compare, typename Allocator>
+bool LockFreeSet<T, Compare, Allocator>::empty() const {
+    return size() == 0;
+}
+
+/*
+ *  Обход по возрастанию, элементы, удаленные по ходу, могут попасть или
+ * не попасть
+ */
+template <typename T, typename Compare, typename Allocator>
+template <typename Function>
+void LockFreeSet<T, Compare, Allocator>::for_each(Function f) const {
+    EpochGuard guard;
+
+    Node *curr = pointer_(head_.load(std::memory_order_acquire));
+    while (curr) {
+        uintptr_t next = curr->next.load(std::memory_order_acquire);
+        if (!(next & mark_)) {
+            f(static_cast<const T &>(curr->elem_));
+        }
+        curr = pointer_(next);
+    }
+}
+
+template <typename T, typename Compare, typename Allocator>
+Allocator LockFreeSet<T, Compare, Allocator>::get_allocator() const {
+    return Allocator(node_allocator_);
+}
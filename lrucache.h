@@ -0,0 +1,496 @@
+#pragma once
+
+#include "concurrentallocator.h"
+#include "fastallocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ *
+ *      LruCache<K, V, Hash, KeyEqual, Allocator>
+ *
+ *      Кэш с вытеснением давно не использованного (LRU)
+ *
+ *      Обычно это std::list плюс std::unordered_map<K, list::iterator>: на
+ * запись две аллокации через разные аллокаторы и лишний поиск. Здесь узел
+ * один - он одновременно элемент двусвязного списка по свежести и элемент
+ * цепочки своей корзины хэш-таблицы. Одна аллокация через Allocator (с
+ * FastAllocator - из пула)
+ *
+ *      Обращение к элементу - O(1): выдернуть узел и поставить в начало
+ *      Когда кэш полон, выкидываем сразу evict_batch самых старых, чтобы
+ * не платить за вытеснение на каждой вставке
+ *
+ */
+
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>,
+          typename Allocator = std::allocator<V> >
+struct LruCache {
+private:
+    struct Node {
+        K key_;
+        V value_;
+        size_t hash_;
+        Node *next;         // к более старым
+        Node *prev;         // к более свежим
+        Node *bucket_next;  // следующий в корзине
+
+        Node(const K &key, const V &value, size_t hash)
+                : key_(key), value_(value), hash_(hash) {}
+    };
+
+public:
+    explicit LruCache(size_t capacity, size_t evict_batch = 1,
+                      const Hash &hash = Hash(),
+                      const KeyEqual &equal = KeyEqual(),
+                      const Allocator &alloc = Allocator());
+    ~LruCache();
+
+    LruCache(const LruCache &) = delete;
+    LruCache &operator=(const LruCache &) = delete;
+
+    V *find(const K &key);
+    const V *peek(const K &key) const;
+    bool contains(const K &key) const;
+
+    void put(const K &key, const V &value);
+    bool erase(const K &key);
+    size_t evict(size_t count);
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const;
+    bool empty() const;
+
+    template <typename Function>
+    void for_each(Function f) const;
+
+    Allocator get_allocator() const;
+
+private:
+    using node_allocator_type_ =
+        typename PoolRebind<Allocator, Node>::type;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+    using bucket_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node *>;
+
+    static const size_t min_buckets_ = 16;
+
+    Node *lookup_(const K &key, size_t hash) const;
+    Node **bucket_(size_t hash);
+
+    void unlink_list_(Node *);
+    void link_front_(Node *);
+    void unlink_bucket_(Node *);
+    void rehash_(size_t buckets);
+    void free_node_(Node *);
+
+    Hash hash_;
+    KeyEqual equal_;
+    node_allocator_type_ node_allocator_;
+    std::vector<Node *, bucket_allocator_type_> buckets_;
+
+    Node *head_ = nullptr;  // самый свежий
+    Node *tail_ = nullptr;  // самый старый
+    size_t size_ = 0;
+    size_t capacity_;
+    size_t evict_batch_;
+};
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+LruCache<K, V, Hash, KeyEqual, Allocator>::LruCache(size_t capacity,
+                                                    size_t evict_batch,
+                                                    const Hash &hash,
+                                                    const KeyEqual &equal,
+                                                    const Allocator &alloc)
+        : hash_(hash),
+          equal_(equal),
+          node_allocator_(alloc),
+          buckets_(min_buckets_, nullptr, bucket_allocator_type_(alloc)),
+          capacity_(capacity == 0 ? 1 : capacity),
+          evict_batch_(evict_batch == 0 ? 1 : evict_batch) {}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+LruCache<K, V, Hash, KeyEqual, Allocator>::~LruCache() {
+    clear();
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename LruCache<K, V, Hash, KeyEqual, Allocator>::Node **
+LruCache<K, V, Hash, KeyEqual, Allocator>::bucket_(size_t hash) {
+    return &buckets_[hash & (buckets_.size() - 1)];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename LruCache<K, V, Hash, KeyEqual, Allocator>::Node *
+LruCache<K, V, Hash, KeyEqual, Allocator>::lookup_(const K &key,
+                                                   size_t hash) const {
+    Node *node = buckets_[hash & (buckets_.size() - 1)];
+    while (node && !(node->hash_ == hash && equal_(node->key_, key))) {
+        node = node->bucket_next;
+    }
+    return node;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::unlink_list_(Node *node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        head_ = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        tail_ = node->prev;
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::link_front_(Node *node) {
+    node->prev = nullptr;
+    node->next = head_;
+    if (head_) {
+        head_->prev = node;
+    } else {
+        tail_ = node;
+    }
+    head_ = node;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::unlink_bucket_(Node *node) {
+    Node **link = bucket_(node->hash_);
+    while (*link != node) {
+        link = &(*link)->bucket_next;
+    }
+    *link = node->bucket_next;
+}
+
+/*
+ *  Число корзин - степень двойки, узлы просто перевешиваются, хэш
+ * хранится в узле и заново не считается
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::rehash_(size_t buckets) {
+    std::vector<Node *, bucket_allocator_type_> fresh(
+        buckets, nullptr, buckets_.get_allocator());
+
+    for (Node *node = head_; node; node = node->next) {
+        Node *&bucket = fresh[node->hash_ & (buckets - 1)];
+        node->bucket_next = bucket;
+        bucket = node;
+    }
+    buckets_.swap(fresh);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::free_node_(Node *node) {
+    node_allocator_traits_::destroy(node_allocator_, node);
+    node_allocator_traits_::deallocate(node_allocator_, node, 1);
+}
+
+/*
+ *  Нашли - передвигаем в начало
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+V *LruCache<K, V, Hash, KeyEqual, Allocator>::find(const K &key) {
+    Node *node = lookup_(key, hash_(key));
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node != head_) {
+        unlink_list_(node);
+        link_front_(node);
+    }
+    return &node->value_;
+}
+
+/*
+ *  Без изменения порядка
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+const V *LruCache<K, V, Hash, KeyEqual, Allocator>::peek(const K &key) const {
+    Node *node = lookup_(key, hash_(key));
+    return node ? &node->value_ : nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool LruCache<K, V, Hash, KeyEqual, Allocator>::contains(const K &key) const {
+    return lookup_(key, hash_(key)) != nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::put(const K &key,
+                                                    const V &value) {
+    size_t hash = hash_(key);
+    Node *node = lookup_(key, hash);
+    if (node) {
+        node->value_ = value;
+        if (node != head_) {
+            unlink_list_(node);
+            link_front_(node);
+        }
+        return;
+    }
+
+    if (size_ >= capacity_) {
+        evict(evict_batch_);
+    }
+
+    node = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, node, key, value,
+                                          hash);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        throw;
+    }
+
+    Node **bucket = bucket_(hash);
+    node->bucket_next = *bucket;
+    *bucket = node;
+    link_front_(node);
+    ++size_;
+
+    if (size_ > buckets_.size()) {
+        rehash_(buckets_.size() * 2);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool LruCache<K, V, Hash, KeyEqual, Allocator>::erase(const K &key) {
+    Node *node = lookup_(key, hash_(key));
+    if (node == nullptr) {
+        return false;
+    }
+
+    unlink_bucket_(node);
+    unlink_list_(node);
+    free_node_(node);
+    --size_;
+    return true;
+}
+
+/*
+ *  Выкинуть count самых старых, вернуть сколько выкинули
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+size_t LruCache<K, V, Hash, KeyEqual, Allocator>::evict(size_t count) {
+    size_t evicted = 0;
+    while (tail_ && evicted < count) {
+        Node *node = tail_;
+        unlink_bucket_(node);
+        unlink_list_(node);
+        free_node_(node);
+        ++evicted;
+    }
+    size_ -= evicted;
+    return evicted;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::clear() {
+    while (head_) {
+        Node *next = head_->next;
+        free_node_(head_);
+        head_ = next;
+    }
+    tail_ = nullptr;
+    size_ = 0;
+    std::fill(buckets_.begin(), buckets_.end(), nullptr);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+size_t LruCache<K, V, Hash, KeyEqual, Allocator>::size() const {
+    return size_;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+size_t LruCache<K, V, Hash, KeyEqual, Allocator>::capacity() const {
+    return capacity_;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool LruCache<K, V, Hash, KeyEqual, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+/*
+ *  От самого свежего к самому старому, f(key, value)
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+template <typename Function>
+void LruCache<K, V, Hash, KeyEqual, Allocator>::for_each(Function f) const {
+    for (const Node *node = head_; node; node = node->next) {
+        f(node->key_, node->value_);
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+Allocator LruCache<K, V, Hash, KeyEqual, Allocator>::get_allocator() const {
+    return Allocator(node_allocator_);
+}
+
+/*
+ *
+ *      ShardedLruCache<K, V, Hash, KeyEqual, Allocator>
+ *
+ *      Для многих потоков: несколько независимых LruCache, каждый под
+ * своим мьютексом, ключ попадает в шард по хэшу. Потоки с разными ключами
+ * почти не мешают друг другу
+ *
+ *      Вместимость делится между шардами поровну, так что LRU - внутри
+ * шарда, а не глобальный
+ *
+ *      Наружу значения отдаются копией: указатель в шард после отпускания
+ * мьютекса был бы небезопасен
+ *
+ */
+
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>,
+          typename Allocator = ConcurrentFastAllocator<V> >
+struct ShardedLruCache {
+    ShardedLruCache(size_t capacity, size_t shards, size_t evict_batch = 1,
+                    const Hash &hash = Hash(),
+                    const KeyEqual &equal = KeyEqual(),
+                    const Allocator &alloc = Allocator());
+
+    bool get(const K &key, V &out);
+    void put(const K &key, const V &value);
+    bool erase(const K &key);
+    void clear();
+
+    size_t size() const;
+    size_t shards() const;
+
+private:
+    struct Shard_ {
+        std::mutex mutex;
+        LruCache<K, V, Hash, KeyEqual, Allocator> cache;
+
+        Shard_(size_t capacity, size_t evict_batch, const Hash &hash,
+               const KeyEqual &equal, const Allocator &alloc)
+                : cache(capacity, evict_batch, hash, equal, alloc) {}
+    };
+
+    Shard_ &shard_(const K &key);
+
+    Hash hash_;
+    std::vector<std::unique_ptr<Shard_> > shards_;
+};
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::ShardedLruCache(
+    size_t capacity, size_t shards, size_t evict_batch, const Hash &hash,
+    const KeyEqual &equal, const Allocator &alloc)
+        : hash_(hash) {
+    if (shards == 0) {
+        shards = 1;
+    }
+
+    size_t per_shard = (capacity + shards - 1) / shards;
+    for (size_t i = 0; i < shards; i++) {
+        shards_.emplace_back(
+            new Shard_(per_shard, evict_batch, hash, equal, alloc));
+    }
+}
+
+/*
+ *  Старшие биты хэша: младшие уже идут на корзины внутри шарда
+ */
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::Shard_ &
+ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::shard_(const K &key) {
+    uint64_t hash = static_cast<uint64_t>(hash_(key)) * 0x9e3779b97f4a7c15ull;
+    return *shards_[(hash >> 40) % shards_.size()];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::get(const K &key,
+                                                           V &out) {
+    Shard_ &shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    V *value = shard.cache.find(key);
+    if (value == nullptr) {
+        return false;
+    }
+    out = *value;
+    return true;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::put(const K &key,
+                                                           const V &value) {
+    Shard_ &shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.put(key, value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::erase(const K &key) {
+    Shard_ &shard = shard_(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.erase(key);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+void ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::clear() {
+    for (size_t i = 0; i < shards_.size(); i++) {
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        shards_[i]->cache.clear();
+    }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+size_t ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::size() const {
+    size_t result = 0;
+    for (size_t i = 0; i < shards_.size(); i++) {
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        result += shards_[i]->cache.size();
+    }
+    return result;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual,
+          typename Allocator>
+size_t ShardedLruCache<K, V, Hash, KeyEqual, Allocator>::shards() const {
+    return shards_.size();
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "concurrentallocator.h"
+#include "fastallocator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/*
+ *
+ *      MpscQueue<T, Allocator>
+ *
+ *      Очередь много писателей - один читатель для передачи сообщений
+ * между потоками (как у Вьюкова: писатель делает один exchange и одну
+ * запись, без циклов и CAS)
+ *
+ *      Узлы - это прямо узлы List<T, Allocator>. Писатель кладет в prev
+ * узла ссылку на предыдущее сообщение, то есть ровно то, что там будет
+ * лежать в List. Читатель одним exchange забирает все накопленное,
+ * проходит с конца и проставляет next - получается готовая цепочка List в
+ * порядке отправки, которую splice_to вешает в конец листа без копий и
+ * без новых аллокаций
+ *
+ *      Писатели выделяют узлы параллельно, поэтому аллокатор по умолчанию
+ * ConcurrentFastAllocator
+ *
+ */
+
+template <typename T, typename Allocator = ConcurrentFastAllocator<T> >
+struct MpscQueue {
+private:
+    using Node = typename List<T, Allocator>::Node;
+    using Chain_ = typename List<T, Allocator>::Chain_;
+
+public:
+    explicit MpscQueue(const Allocator &alloc = Allocator());
+    ~MpscQueue();
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // писатели
+    void push(const T &value);
+
+    // читатель
+    bool try_pop(T &out);
+    size_t splice_to(List<T, Allocator> &list);
+    template <typename Function>
+    size_t consume_all(Function f);
+    bool empty() const;
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    static Node *pending_();
+    static Node *load_prev_(Node *);
+
+    Chain_ take_all_(size_t &count);
+    void free_node_(Node *);
+
+    node_allocator_type_ node_allocator_;
+
+    // самое свежее сообщение, сюда пишут все писатели
+    alignas(64) std::atomic<Node *> head_{nullptr};
+
+    // уже забранное, но еще не отданное через try_pop (только читатель)
+    alignas(64) Node *popped_ = nullptr;
+};
+
+template <typename T, typename Allocator>
+MpscQueue<T, Allocator>::MpscQueue(const Allocator &alloc)
+        : node_allocator_(alloc) {}
+
+/*
+ *  Писателей к этому моменту быть не должно
+ */
+template <typename T, typename Allocator>
+MpscQueue<T, Allocator>::~MpscQueue() {
+    consume_all([](const T &) {});
+}
+
+/*
+ *  Метка "ссылку на предыдущего еще не записали"
+ */
+template <typename T, typename Allocator>
+typename MpscQueue<T, Allocator>::Node *MpscQueue<T, Allocator>::pending_() {
+    return reinterpret_cast<Node *>(static_cast<uintptr_t>(1));
+}
+
+/*
+ *  prev в узле List - обычный указатель, поэтому атомарно читаем и пишем
+ * его через встроенные __atomic функции gcc/clang
+ *  Писатель между exchange и записью prev - буквально пара инструкций,
+ * так что подождать его можно на месте
+ */
+template <typename T, typename Allocator>
+typename MpscQueue<T, Allocator>::Node *MpscQueue<T, Allocator>::load_prev_(
+    Node *node) {
+    Node *prev = __atomic_load_n(&node->prev, __ATOMIC_ACQUIRE);
+    while (prev == pending_()) {
+        std::this_thread::yield();
+        prev = __atomic_load_n(&node->prev, __ATOMIC_ACQUIRE);
+    }
+    return prev;
+}
+
+template <typename T, typename Allocator>
+void MpscQueue<T, Allocator>::push(const T &value) {
+    Node *node = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, node, value);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        throw;
+    }
+
+    node->prev = pending_();
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    __atomic_store_n(&node->prev, prev, __ATOMIC_RELEASE);
+}
+
+/*
+ *  Забираем все одним exchange и идем от свежих к старым, проставляя
+ * next. Самый старый узел в пачке - тот, у кого prev == nullptr
+ */
+template <typename T, typename Allocator>
+typename MpscQueue<T, Allocator>::Chain_ MpscQueue<T, Allocator>::take_all_(
+    size_t &count) {
+    count = 0;
+    Node *last = head_.exchange(nullptr, std::memory_order_acq_rel);
+    if (last == nullptr) {
+        return Chain_{nullptr, nullptr};
+    }
+
+    last->next = nullptr;
+    Node *node = last;
+    count = 1;
+    for (Node *prev = load_prev_(node); prev; prev = load_prev_(node)) {
+        prev->next = node;
+        node = prev;
+        ++count;
+    }
+    return Chain_{node, last};
+}
+
+template <typename T, typename Allocator>
+void MpscQueue<T, Allocator>::free_node_(Node *node) {
+    node_allocator_traits_::destroy(node_allocator_, node);
+    node_allocator_traits_::deallocate(node_allocator_, node, 1);
+}
+
+template <typename T, typename Allocator>
+bool MpscQueue<T, Allocator>::try_pop(T &out) {
+    if (popped_ == nullptr) {
+        size_t count;
+        popped_ = take_all_(count).first;
+        if (popped_ == nullptr) {
+            return false;
+        }
+    }
+
+    Node *node = popped_;
+    out = std::move(node->elem_);
+    popped_ = node->next;
+    free_node_(node);
+    return true;
+}
+
+/*
+ *  Все сообщения - в конец list за один exchange, узлы переходят к
+ * листу как есть
+ */
+template <typename T, typename Allocator>
+size_t MpscQueue<T, Allocator>::splice_to(List<T, Allocator> &list) {
+    size_t count = 0;
+    if (popped_) {
+        Node *last = popped_;
+        count = 1;
+        while (last->next) {
+            last = last->next;
+            ++count;
+        }
+        list.link_chain_(list.end_, Chain_{popped_, last}, count);
+        popped_ = nullptr;
+    }
+
+    size_t taken;
+    Chain_ chain = take_all_(taken);
+    list.link_chain_(list.end_, chain, taken);
+    return count + taken;
+}
+
+/*
+ *  Отдать f все, что накопилось, по порядку, и сразу освободить узлы
+ */
+template <typename T, typename Allocator>
+template <typename Function>
+size_t MpscQueue<T, Allocator>::consume_all(Function f) {
+    size_t count = 0;
+    while (true) {
+        if (popped_ == nullptr) {
+            size_t taken;
+            popped_ = take_all_(taken).first;
+            if (popped_ == nullptr) {
+                return count;
+            }
+        }
+
+        Node *node = popped_;
+        popped_ = node->next;
+        f(static_cast<const T &>(node->elem_));
+        free_node_(node);
+        ++count;
+    }
+}
+
+/*
+ *  Для читателя: true - сейчас забрать нечего
+ */
+template <typename T, typename Allocator>
+bool MpscQueue<T, Allocator>::empty() const {
+    return popped_ == nullptr &&
+           head_.load(std::memory_order_acquire) == nullptr;
+}
@@ -0,0 +1,641 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ *      ThreadPool
+ *
+ *      Пул потоков с воровством задач (work stealing)
+ *      У каждого воркера своя очередь: свои задачи он берет с конца (так
+ * свежие данные еще в кэше), а когда своих нет - ворует из начала чужих
+ * очередей
+ *
+ *      Пул тоже синглтон, как и FixedAllocator: создается один раз на всю
+ * прогу при первом обращении
+ *
+ */
+
+struct ThreadPool {
+private:
+    struct Queue_ {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue_>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_queue_{0};
+    bool stop_ = false;
+
+    static const size_t npos_ = static_cast<size_t>(-1);
+
+    static size_t &current_index_();
+
+    bool pop_own_(std::function<void()> &);
+    bool steal_(std::function<void()> &);
+
+    void worker_loop_(size_t);
+
+    explicit ThreadPool(size_t threads);
+
+public:
+    static ThreadPool *getThreadPool();
+
+    ~ThreadPool();
+
+    size_t size() const;
+
+    void submit(std::function<void()> task);
+
+    bool try_run_one();
+};
+
+/*
+ *  Номер воркера текущего потока, npos_ для чужих потоков
+ */
+inline size_t &ThreadPool::current_index_() {
+    static thread_local size_t index = npos_;
+    return index;
+}
+
+inline ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        queues_.emplace_back(new Queue_());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back(&ThreadPool::worker_loop_, this, i);
+    }
+}
+
+inline ThreadPool *ThreadPool::getThreadPool() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return &pool;
+}
+
+inline ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        threads_[i].join();
+    }
+}
+
+inline size_t ThreadPool::size() const {
+    return threads_.size();
+}
+
+/*
+ *  Задачу, порожденную воркером, кладем в его же очередь
+ *  Задачи снаружи раскидываем по очередям по кругу
+ */
+inline void ThreadPool::submit(std::function<void()> task) {
+    size_t index = current_index_();
+    if (index == npos_) {
+        index = next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                queues_.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wakeup_.notify_one();
+}
+
+inline bool ThreadPool::pop_own_(std::function<void()> &task) {
+    size_t index = current_index_();
+    if (index == npos_) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    if (queues_[index]->tasks.empty()) {
+        return false;
+    }
+    task = std::move(queues_[index]->tasks.back());
+    queues_[index]->tasks.pop_back();
+    return true;
+}
+
+inline bool ThreadPool::steal_(std::function<void()> &task) {
+    size_t index = current_index_();
+    size_t start = index == npos_ ? 0 : index + 1;
+
+    for (size_t i = 0; i < queues_.size(); i++) {
+        Queue_ &victim = *queues_[(start + i) % queues_.size()];
+
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ *  Выполнить одну задачу, если она найдется
+ *  Этим пользуются и ожидающие потоки, чтобы не простаивать (и чтобы
+ * вложенные задачи не могли зависнуть)
+ */
+inline bool ThreadPool::try_run_one() {
+    std::function<void()> task;
+    if (!pop_own_(task) && !steal_(task)) {
+        return false;
+    }
+
+    queued_.fetch_sub(1);
+    task();
+    return true;
+}
+
+inline void ThreadPool::worker_loop_(size_t index) {
+    current_index_() = index;
+
+    while (true) {
+        if (try_run_one()) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wakeup_.wait(lock, [this]() { return stop_ || queued_.load() > 0; });
+        if (stop_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+/*
+ *
+ *      TaskGroup
+ *
+ *      Группа задач для fork-join: run() отдает задачу в пул, wait() ждет
+ * все задачи группы, выполняя пока что-нибудь из пула сам
+ *
+ *      Исключение из задачи ловится внутри нее (иначе на рабочем потоке
+ * это std::terminate), первое сохраняется и выбрасывается из wait(),
+ * когда закончатся все задачи группы. Деструктор только ждет
+ *
+ */
+
+struct TaskGroup {
+private:
+    ThreadPool *pool_;
+    std::atomic<size_t> pending_{0};
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+
+    void wait_();
+
+public:
+    explicit TaskGroup(ThreadPool *pool = ThreadPool::getThreadPool());
+    ~TaskGroup();
+
+    template <typename Function>
+    void run(Function f);
+
+    void wait();
+};
+
+inline TaskGroup::TaskGroup(ThreadPool *pool) : pool_(pool) {}
+
+inline TaskGroup::~TaskGroup() {
+    wait_();
+}
+
+template <typename Function>
+void TaskGroup::run(Function f) {
+    pending_.fetch_add(1);
+    pool_->submit([this, f]() mutable {
+        try {
+            f();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+        pending_.fetch_sub(1);
+    });
+}
+
+inline void TaskGroup::wait_() {
+    while (pending_.load() > 0) {
+        if (!pool_->try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void TaskGroup::wait() {
+    wait_();
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/*
+ *
+ *      Точки разбиения
+ *
+ *      По листу нельзя прыгнуть в середину, поэтому границы кусков для
+ * потоков считаются одним проходом заранее и потом переиспользуются
+ * сколько угодно раз, пока структура листа не меняется
+ *      В векторе parts + 1 итератор: кусок k - это [points[k], points[k + 1])
+ *
+ */
+
+template <typename Iterator>
+std::vector<Iterator> split_points(Iterator first, Iterator last, size_t size,
+                                   size_t parts) {
+    if (parts > size) {
+        parts = size;
+    }
+    if (parts == 0) {
+        parts = 1;
+    }
+
+    std::vector<Iterator> points;
+    points.reserve(parts + 1);
+    points.push_back(first);
+
+    size_t chunk = size / parts;
+    size_t extra = size % parts;
+
+    for (size_t k = 0; k + 1 < parts; k++) {
+        size_t step = chunk + (k < extra ? 1 : 0);
+        for (size_t i = 0; i < step; i++) {
+            ++first;
+        }
+        points.push_back(first);
+    }
+    points.push_back(last);
+
+    return points;
+}
+
+/*
+ *  По умолчанию кусков в несколько раз больше, чем потоков, чтобы
+ * воровство задач выравнивало неравномерную работу
+ */
+inline size_t default_parallel_parts() {
+    return ThreadPool::getThreadPool()->size() * 4;
+}
+
+template <typename T, typename Allocator>
+std::vector<typename List<T, Allocator>::iterator> split_points(
+    List<T, Allocator> &list, size_t parts = default_parallel_parts()) {
+    return split_points(list.begin(), list.end(), list.size(), parts);
+}
+
+template <typename T, typename Allocator>
+std::vector<typename List<T, Allocator>::const_iterator> split_points(
+    const List<T, Allocator> &list, size_t parts = default_parallel_parts()) {
+    return split_points(list.cbegin(), list.cend(), list.size(), parts);
+}
+
+/*
+ *
+ *      Параллельные алгоритмы
+ *
+ *      Все принимают либо лист (и тогда сами считают точки разбиения),
+ * либо уже посчитанные точки
+ *
+ */
+
+template <typename Iterator, typename Function>
+void parallel_for_each(const std::vector<Iterator> &points, Function f) {
+    TaskGroup group;
+    for (size_t k = 0; k + 1 < points.size(); k++) {
+        Iterator first = points[k];
+        Iterator last = points[k + 1];
+        group.run([first, last, f]() mutable {
+            for (Iterator it = first; it != last; ++it) {
+                f(*it);
+            }
+        });
+    }
+    group.wait();
+}
+
+template <typename T, typename Allocator, typename Function>
+void parallel_for_each(List<T, Allocator> &list, Function f) {
+    parallel_for_each(split_points(list), f);
+}
+
+/*
+ *  Каждый кусок сворачивается отдельно, начиная со своего первого
+ * элемента, так что нейтральный элемент не нужен: init участвует ровно
+ * один раз, при сборке частичных результатов
+ */
+template <typename Iterator, typename Result, typename Reduce,
+          typename Transform>
+Result parallel_transform_reduce(const std::vector<Iterator> &points,
+                                 Result init, Reduce reduce,
+                                 Transform transform) {
+    size_t parts = points.empty() ? 0 : points.size() - 1;
+    std::vector<Result> partial(parts, init);
+    std::vector<char> filled(parts, 0);
+
+    TaskGroup group;
+    for (size_t k = 0; k < parts; k++) {
+        group.run([&, k]() {
+            Iterator it = points[k];
+            Iterator last = points[k + 1];
+            if (it == last) {
+                return;
+            }
+
+            Reduce local_reduce = reduce;
+            Transform local_transform = transform;
+
+            Result acc = local_transform(*it);
+            for (++it; it != last; ++it) {
+                acc = local_reduce(acc, local_transform(*it));
+            }
+
+            partial[k] = acc;
+            filled[k] = 1;
+        });
+    }
+    group.wait();
+
+    Result result = init;
+    for (size_t k = 0; k < parts; k++) {
+        if (filled[k]) {
+            result = reduce(result, partial[k]);
+        }
+    }
+    return result;
+}
+
+template <typename T, typename Allocator, typename Result, typename Reduce,
+          typename Transform>
+Result parallel_transform_reduce(const List<T, Allocator> &list, Result init,
+                                 Reduce reduce, Transform transform) {
+    return parallel_transform_reduce(split_points(list), init, reduce,
+                                     transform);
+}
+
+template <typename Iterator, typename Predicate>
+size_t parallel_count_if(const std::vector<Iterator> &points, Predicate pred) {
+    return parallel_transform_reduce(
+        points, size_t(0), std::plus<size_t>(),
+        [pred](const typename std::iterator_traits<Iterator>::value_type &x) {
+            return pred(x) ? size_t(1) : size_t(0);
+        });
+}
+
+template <typename T, typename Allocator, typename Predicate>
+size_t parallel_count_if(const List<T, Allocator> &list, Predicate pred) {
+    return parallel_count_if(split_points(list), pred);
+}
+
+/*
+ *
+ *      ListParallel<T, Allocator>
+ *
+ *      То, что должно лезть во внутренности List: сортировка и сборка
+ * работают прямо с узлами
+ *
+ */
+
+template <typename T, typename Allocator>
+struct ListParallel {
+    using list_type_ = List<T, Allocator>;
+    using Node = typename list_type_::Node;
+    using Chain_ = typename list_type_::Chain_;
+    using node_allocator_traits_ =
+        typename list_type_::node_allocator_traits_;
+
+    /*
+     *  Меньше этого параллелить сортировку нет смысла
+     */
+    static const size_t min_sort_chunk_ = 1 << 14;
+
+    template <typename Compare>
+    static void sort(list_type_ &, Compare);
+
+    template <typename ForwardIt>
+    static void append(list_type_ &, ForwardIt, size_t);
+};
+
+/*
+ *  Режем лист на куски, каждый кусок сортируем в своей задаче, потом
+ * сливаем попарно, пока не останется одна цепочка
+ *  Узлы только перевешиваются, память не трогаем вообще
+ *  comp не должен бросать: цепочки к этому моменту сняты с листа и
+ * наполовину перевешаны, собрать их обратно уже не из чего
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+void ListParallel<T, Allocator>::sort(list_type_ &list, Compare comp) {
+    size_t count = list.size();
+    size_t parts = default_parallel_parts();
+    if (parts > count / min_sort_chunk_) {
+        parts = count / min_sort_chunk_;
+    }
+    if (parts <= 1) {
+        list.sort(comp);
+        return;
+    }
+
+    std::vector<Node *> heads(parts);
+    std::vector<size_t> sizes(parts);
+    std::vector<Chain_> chains(parts);
+
+    Node *cursor = list.detach_chain_().first;
+    for (size_t k = 0; k < parts; k++) {
+        sizes[k] = count / parts + (k < count % parts ? 1 : 0);
+        heads[k] = cursor;
+        for (size_t i = 0; i < sizes[k]; i++) {
+            cursor = cursor->next;
+        }
+    }
+
+    {
+        TaskGroup group;
+        for (size_t k = 0; k < parts; k++) {
+            group.run([&, k]() {
+                Compare local_comp = comp;
+                Node *head = heads[k];
+                chains[k] = list_type_::sort_chain_(head, sizes[k], local_comp);
+            });
+        }
+        group.wait();
+    }
+
+    while (chains.size() > 1) {
+        std::vector<Chain_> merged((chains.size() + 1) / 2);
+
+        TaskGroup group;
+        for (size_t k = 0; k < merged.size(); k++) {
+            if (2 * k + 1 == chains.size()) {
+                merged[k] = chains[2 * k];
+                continue;
+            }
+            group.run([&, k]() {
+                Compare local_comp = comp;
+                merged[k] = list_type_::merge_chains_(
+                    chains[2 * k], chains[2 * k + 1], local_comp);
+            });
+        }
+        group.wait();
+
+        chains.swap(merged);
+    }
+
+    list.link_chain_(list.end_, chains[0], count);
+}
+
+/*
+ *  FixedAllocator однопоточный, поэтому узлы выделяются здесь, в
+ * вызывающем потоке, и сразу нарезаются на цепочки по одной на задачу
+ *  Копирование элементов и связывание - уже параллельно, каждая задача
+ * собирает свой подсписок, а потом подсписки склеиваются за O(кусков)
+ *  Если конструктор элемента бросил, все узлы разбираются обратно, а лист
+ * остается как был
+ */
+template <typename T, typename Allocator>
+template <typename ForwardIt>
+void ListParallel<T, Allocator>::append(list_type_ &list, ForwardIt first,
+                                        size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t parts = default_parallel_parts();
+    if (parts > count) {
+        parts = count;
+    }
+
+    std::vector<Chain_> chains(parts);
+    std::vector<size_t> sizes(parts);
+    std::vector<size_t> constructed(parts, 0);
+    std::vector<ForwardIt> sources(parts);
+
+    for (size_t k = 0; k < parts; k++) {
+        sizes[k] = count / parts + (k < count % parts ? 1 : 0);
+        sources[k] = first;
+        std::advance(first, sizes[k]);
+
+        Node *prev = nullptr;
+        for (size_t i = 0; i < sizes[k]; i++) {
+            Node *node = node_allocator_traits_::allocate(list.node_allocator_, 1);
+            node->next = nullptr;
+            if (prev) {
+                prev->next = node;
+            } else {
+                chains[k].first = node;
+            }
+            prev = node;
+        }
+        chains[k].last = prev;
+    }
+
+    {
+        TaskGroup group;
+        for (size_t k = 0; k < parts; k++) {
+            group.run([&, k]() {
+                ForwardIt source = sources[k];
+                Node *prev = nullptr;
+                Node *node = chains[k].first;
+
+                for (size_t i = 0; i < sizes[k]; i++, ++source) {
+                    Node *next = node->next;
+                    node_allocator_traits_::construct(list.node_allocator_,
+                                                      node, *source);
+                    constructed[k]++;
+                    node->prev = prev;
+                    node->next = next;
+                    prev = node;
+                    node = next;
+                }
+            });
+        }
+
+        try {
+            group.wait();
+        } catch (...) {
+            for (size_t k = 0; k < parts; k++) {
+                Node *node = chains[k].first;
+                for (size_t i = 0; i < sizes[k]; i++) {
+                    Node *next = node->next;
+                    if (i < constructed[k]) {
+                        node_allocator_traits_::destroy(list.node_allocator_,
+                                                        node);
+                    }
+                    node_allocator_traits_::deallocate(list.node_allocator_,
+                                                       node, 1);
+                    node = next;
+                }
+            }
+            throw;
+        }
+    }
+
+    for (size_t k = 0; k + 1 < parts; k++) {
+        chains[k].last->next = chains[k + 1].first;
+        chains[k + 1].first->prev = chains[k].last;
+    }
+
+    list.link_chain_(list.end_, Chain_{chains[0].first, chains[parts - 1].last},
+                     count);
+}
+
+template <typename T, typename Allocator>
+void parallel_sort(List<T, Allocator> &list) {
+    ListParallel<T, Allocator>::sort(list, std::less<T>());
+}
+
+template <typename T, typename Allocator, typename Compare>
+void parallel_sort(List<T, Allocator> &list, Compare comp) {
+    ListParallel<T, Allocator>::sort(list, comp);
+}
+
+/*
+ *  Дописывает [first, last) в конец листа
+ */
+template <typename T, typename Allocator, typename ForwardIt>
+void parallel_build(List<T, Allocator> &list, ForwardIt first,
+                    ForwardIt last) {
+    size_t count = std::distance(first, last);
+    ListParallel<T, Allocator>::append(list, first, count);
+}
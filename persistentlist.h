@@ -0,0 +1,621 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <atomic>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/*
+ *
+ *      Счетчики ссылок для PersistentList
+ *
+ *      LocalRefCount - обычное число, если версии живут в одном потоке
+ *      SharedRefCount - атомарный: увеличение relaxed (новая ссылка
+ * появляется только от уже живой), синхронизирует только уменьшение
+ *
+ *      Интерфейс: acquire() и release(), release возвращает true, если
+ * ссылок больше нет
+ *
+ */
+
+struct LocalRefCount {
+    void acquire() {
+        ++count_;
+    }
+
+    bool release() {
+        return --count_ == 0;
+    }
+
+private:
+    size_t count_ = 1;
+};
+
+struct SharedRefCount {
+    void acquire() {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool release() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+private:
+    std::atomic<size_t> count_{1};
+};
+
+/*
+ *
+ *      PersistentList<T, Allocator, RefCount>
+ *
+ *      Неизменяемый односвязный список. Все "изменения" возвращают новую
+ * версию, а старая остается как была. Версии делят общий хвост: менять
+ * элемент с номером i - значит скопировать первые i узлов, остальное
+ * общее
+ *
+ *      Копия версии - O(1), push_front/pop_front - O(1),
+ * set/insert/erase по индексу - O(индекс)
+ *
+ *      Узлы со счетчиком ссылок выделяются через Allocator (с FastAllocator
+ * - из пула). Узел освобождается, когда на него не ссылается ни одна
+ * версия и ни один другой узел. Освобождение идет циклом, а не рекурсией,
+ * так что длинный список не переполнит стек
+ *
+ *      Если версии передаются между потоками, нужен SharedRefCount и
+ * потокобезопасный аллокатор (FixedAllocator однопоточный)
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T>,
+          typename RefCount = LocalRefCount>
+struct PersistentList {
+private:
+    struct Node {
+        RefCount refs_;
+        Node *next;
+        T elem_;
+
+        Node(Node *next, const T &elem) : next(next), elem_(elem) {}
+    };
+
+public:
+    class const_iterator;
+    typedef const_iterator iterator;
+
+    explicit PersistentList(const Allocator &alloc = Allocator());
+    PersistentList(std::initializer_list<T> elems,
+                   const Allocator &alloc = Allocator());
+    template <typename ListAllocator>
+    explicit PersistentList(const List<T, ListAllocator> &list,
+                            const Allocator &alloc = Allocator());
+
+    PersistentList(const PersistentList &rhs);
+    PersistentList(PersistentList &&rhs);
+    PersistentList &operator=(const PersistentList &rhs);
+    PersistentList &operator=(PersistentList &&rhs);
+    ~PersistentList();
+
+    size_t size() const;
+    bool empty() const;
+
+    const T &front() const;
+    const T &at(size_t) const;
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    PersistentList push_front(const T &value) const;
+    PersistentList pop_front() const;
+    PersistentList push_back(const T &value) const;
+
+    PersistentList set(size_t index, const T &value) const;
+    PersistentList insert(size_t index, const T &value) const;
+    PersistentList erase(size_t index) const;
+
+    bool shares_tail_with(const PersistentList &other) const;
+
+    template <typename ListAllocator>
+    void thaw(List<T, ListAllocator> &) const;
+
+    Allocator get_allocator() const;
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    PersistentList(const node_allocator_type_ &alloc, Node *head, size_t size);
+
+    Node *new_node_(Node *next, const T &value) const;
+    void release_(Node *) const;
+    Node *copy_prefix_(size_t count, Node *tail, Node *&last) const;
+
+    mutable node_allocator_type_ node_allocator_;
+    Node *head_ = nullptr;
+    size_t size_ = 0;
+};
+
+/*
+ *
+ *      const_iterator
+ *
+ */
+
+template <typename T, typename Allocator, typename RefCount>
+class PersistentList<T, Allocator, RefCount>::const_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator() = default;
+
+    const T &operator*() const;
+    const T *operator->() const;
+
+    const_iterator &operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator &rhs) const;
+    bool operator!=(const const_iterator &rhs) const;
+    friend struct PersistentList<T, Allocator, RefCount>;
+
+private:
+    explicit const_iterator(const Node *node);
+
+    const Node *ptr_ = nullptr;
+};
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::const_iterator::const_iterator(
+    const Node *node)
+        : ptr_(node) {}
+
+template <typename T, typename Allocator, typename RefCount>
+const T &PersistentList<T, Allocator, RefCount>::const_iterator::operator*()
+    const {
+    return ptr_->elem_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+const T *PersistentList<T, Allocator, RefCount>::const_iterator::operator->()
+    const {
+    return &ptr_->elem_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator &
+PersistentList<T, Allocator, RefCount>::const_iterator::operator++() {
+    ptr_ = ptr_->next;
+    return *this;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator
+PersistentList<T, Allocator, RefCount>::const_iterator::operator++(int) {
+    const_iterator other = *this;
+    ptr_ = ptr_->next;
+    return other;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+bool PersistentList<T, Allocator, RefCount>::const_iterator::operator==(
+    const const_iterator &rhs) const {
+    return ptr_ == rhs.ptr_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+bool PersistentList<T, Allocator, RefCount>::const_iterator::operator!=(
+    const const_iterator &rhs) const {
+    return ptr_ != rhs.ptr_;
+}
+
+/*
+ *
+ *      Узлы
+ *
+ */
+
+/*
+ *  Новый узел забирает ссылку на next у того, кто его создает: вызывающий
+ * должен был сделать acquire (или отдать свою)
+ */
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::Node *
+PersistentList<T, Allocator, RefCount>::new_node_(Node *next,
+                                                  const T &value) const {
+    Node *node = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, node, next, value);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        throw;
+    }
+    return node;
+}
+
+/*
+ *  Отпускаем ссылку на node. Если она была последней, узел удаляется и
+ * отпускается ссылка на следующий - и так пока не дойдем до общего узла
+ */
+template <typename T, typename Allocator, typename RefCount>
+void PersistentList<T, Allocator, RefCount>::release_(Node *node) const {
+    while (node && node->refs_.release()) {
+        Node *next = node->next;
+        node_allocator_traits_::destroy(node_allocator_, node);
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        node = next;
+    }
+}
+
+/*
+ *  Копии первых count узлов, последняя копия смотрит на tail
+ *  Ссылку на tail вызывающий передает копии сам
+ */
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::Node *
+PersistentList<T, Allocator, RefCount>::copy_prefix_(size_t count, Node *tail,
+                                                     Node *&last) const {
+    Node *first = nullptr;
+    last = nullptr;
+    Node *source = head_;
+
+    try {
+        for (size_t i = 0; i < count; i++, source = source->next) {
+            Node *node = new_node_(nullptr, source->elem_);
+            if (last) {
+                last->next = node;
+            } else {
+                first = node;
+            }
+            last = node;
+        }
+    } catch (...) {
+        release_(first);
+        throw;
+    }
+
+    if (last) {
+        last->next = tail;
+    }
+    return first;
+}
+
+/*
+ *
+ *      PersistentList
+ *
+ */
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::PersistentList(const Allocator &alloc)
+        : node_allocator_(alloc) {}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::PersistentList(
+    const node_allocator_type_ &alloc, Node *head, size_t size)
+        : node_allocator_(alloc), head_(head), size_(size) {}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::PersistentList(
+    std::initializer_list<T> elems, const Allocator &alloc)
+        : node_allocator_(alloc) {
+    Node *last = nullptr;
+    try {
+        for (const T &elem : elems) {
+            Node *node = new_node_(nullptr, elem);
+            if (last) {
+                last->next = node;
+            } else {
+                head_ = node;
+            }
+            last = node;
+            ++size_;
+        }
+    } catch (...) {
+        release_(head_);
+        throw;
+    }
+}
+
+template <typename T, typename Allocator, typename RefCount>
+template <typename ListAllocator>
+PersistentList<T, Allocator, RefCount>::PersistentList(
+    const List<T, ListAllocator> &list, const Allocator &alloc)
+        : node_allocator_(alloc) {
+    Node *last = nullptr;
+    try {
+        for (auto it = list.cbegin(); it != list.cend(); ++it) {
+            Node *node = new_node_(nullptr, *it);
+            if (last) {
+                last->next = node;
+            } else {
+                head_ = node;
+            }
+            last = node;
+            ++size_;
+        }
+    } catch (...) {
+        release_(head_);
+        throw;
+    }
+}
+
+/*
+ *  Копия версии - просто еще одна ссылка на голову
+ */
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::PersistentList(
+    const PersistentList &rhs)
+        : node_allocator_(node_allocator_traits_::
+                              select_on_container_copy_construction(
+                                  rhs.node_allocator_)),
+          head_(rhs.head_),
+          size_(rhs.size_) {
+    if (head_) {
+        head_->refs_.acquire();
+    }
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::PersistentList(PersistentList &&rhs)
+        : node_allocator_(std::move(rhs.node_allocator_)),
+          head_(rhs.head_),
+          size_(rhs.size_) {
+    rhs.head_ = nullptr;
+    rhs.size_ = 0;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount> &
+PersistentList<T, Allocator, RefCount>::operator=(const PersistentList &rhs) {
+    if (rhs.head_) {
+        rhs.head_->refs_.acquire();
+    }
+    release_(head_);
+
+    node_allocator_ = rhs.node_allocator_;
+    head_ = rhs.head_;
+    size_ = rhs.size_;
+    return *this;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount> &
+PersistentList<T, Allocator, RefCount>::operator=(PersistentList &&rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    release_(head_);
+
+    node_allocator_ = std::move(rhs.node_allocator_);
+    head_ = rhs.head_;
+    size_ = rhs.size_;
+    rhs.head_ = nullptr;
+    rhs.size_ = 0;
+    return *this;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>::~PersistentList() {
+    release_(head_);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+size_t PersistentList<T, Allocator, RefCount>::size() const {
+    return size_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+bool PersistentList<T, Allocator, RefCount>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+const T &PersistentList<T, Allocator, RefCount>::front() const {
+    return head_->elem_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+const T &PersistentList<T, Allocator, RefCount>::at(size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("PersistentList::at");
+    }
+
+    Node *node = head_;
+    for (size_t i = 0; i < index; i++) {
+        node = node->next;
+    }
+    return node->elem_;
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator
+PersistentList<T, Allocator, RefCount>::begin() const {
+    return const_iterator(head_);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator
+PersistentList<T, Allocator, RefCount>::cbegin() const {
+    return const_iterator(head_);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator
+PersistentList<T, Allocator, RefCount>::end() const {
+    return const_iterator();
+}
+
+template <typename T, typename Allocator, typename RefCount>
+typename PersistentList<T, Allocator, RefCount>::const_iterator
+PersistentList<T, Allocator, RefCount>::cend() const {
+    return const_iterator();
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::push_front(const T &value) const {
+    Node *node = new_node_(head_, value);
+    if (head_) {
+        head_->refs_.acquire();
+    }
+    return PersistentList(node_allocator_, node, size_ + 1);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::pop_front() const {
+    if (size_ == 0) {
+        throw std::out_of_range("PersistentList::pop_front");
+    }
+
+    Node *next = head_->next;
+    if (next) {
+        next->refs_.acquire();
+    }
+    return PersistentList(node_allocator_, next, size_ - 1);
+}
+
+/*
+ *  В конец - это O(n): копируется весь список
+ */
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::push_back(const T &value) const {
+    return insert(size_, value);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::set(size_t index,
+                                            const T &value) const {
+    if (index >= size_) {
+        throw std::out_of_range("PersistentList::set");
+    }
+
+    Node *node = head_;
+    for (size_t i = 0; i < index; i++) {
+        node = node->next;
+    }
+
+    Node *tail = node->next;
+    Node *changed = new_node_(tail, value);
+
+    Node *last;
+    Node *first;
+    try {
+        first = copy_prefix_(index, changed, last);
+    } catch (...) {
+        node_allocator_traits_::destroy(node_allocator_, changed);
+        node_allocator_traits_::deallocate(node_allocator_, changed, 1);
+        throw;
+    }
+
+    if (tail) {
+        tail->refs_.acquire();
+    }
+    return PersistentList(node_allocator_, first ? first : changed, size_);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::insert(size_t index,
+                                               const T &value) const {
+    if (index > size_) {
+        throw std::out_of_range("PersistentList::insert");
+    }
+
+    Node *tail = head_;
+    for (size_t i = 0; i < index; i++) {
+        tail = tail->next;
+    }
+
+    Node *inserted = new_node_(tail, value);
+
+    Node *last;
+    Node *first;
+    try {
+        first = copy_prefix_(index, inserted, last);
+    } catch (...) {
+        node_allocator_traits_::destroy(node_allocator_, inserted);
+        node_allocator_traits_::deallocate(node_allocator_, inserted, 1);
+        throw;
+    }
+
+    if (tail) {
+        tail->refs_.acquire();
+    }
+    return PersistentList(node_allocator_, first ? first : inserted,
+                          size_ + 1);
+}
+
+template <typename T, typename Allocator, typename RefCount>
+PersistentList<T, Allocator, RefCount>
+PersistentList<T, Allocator, RefCount>::erase(size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("PersistentList::erase");
+    }
+
+    Node *node = head_;
+    for (size_t i = 0; i < index; i++) {
+        node = node->next;
+    }
+
+    Node *tail = node->next;
+    Node *last;
+    Node *first = copy_prefix_(index, tail, last);
+
+    if (tail) {
+        tail->refs_.acquire();
+    }
+    return PersistentList(node_allocator_, first ? first : tail, size_ - 1);
+}
+
+/*
+ *  Делят ли версии хоть один узел (общий хвост)
+ */
+template <typename T, typename Allocator, typename RefCount>
+bool PersistentList<T, Allocator, RefCount>::shares_tail_with(
+    const PersistentList &other) const {
+    const PersistentList *longer = size_ >= other.size_ ? this : &other;
+    const PersistentList *shorter = longer == this ? &other : this;
+
+    Node *a = longer->head_;
+    for (size_t i = shorter->size_; i < longer->size_; i++) {
+        a = a->next;
+    }
+
+    // общий хвост одинаковой длины, так что идем синхронно
+    for (Node *b = shorter->head_; a; a = a->next, b = b->next) {
+        if (a == b) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ *  Как FrozenList::thaw: содержимое list заменяется элементами версии
+ */
+template <typename T, typename Allocator, typename RefCount>
+template <typename ListAllocator>
+void PersistentList<T, Allocator, RefCount>::thaw(
+    List<T, ListAllocator> &list) const {
+    list.clear();
+    list.insert(list.cend(), cbegin(), cend());
+}
+
+template <typename T, typename Allocator, typename RefCount>
+Allocator PersistentList<T, Allocator, RefCount>::get_allocator() const {
+    return Allocator(node_allocator_);
+}
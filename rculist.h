@@ -0,0 +1,375 @@
+#pragma once
+
+#include "epochdomain.h"
+#include "fastallocator.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ *
+ *      RcuList<T, Allocator>
+ *
+ *      Список в стиле RCU: много читателей без блокировок, редкие писатели
+ *
+ *      Читатели ходят по списку, не беря мьютекс и ничего не записывая в
+ * общую память, кроме своего слота эпохи при входе. Писатели
+ * сериализуются мьютексом между собой, но читателям не мешают: новый
+ * узел сначала целиком строится, потом публикуется одной записью
+ * указателя с release
+ *
+ *      Элементы не меняются на месте: update_if строит копию узла и
+ * подменяет старый
+ *
+ *      Выкинутые узлы копятся и освобождаются пачкой, когда все читатели,
+ * которые могли их видеть, вышли. Выделяют и освобождают узлы только
+ * писатели под мьютексом списка
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct RcuList {
+private:
+    struct Node {
+        std::atomic<Node *> next;
+        T elem_;
+
+        explicit Node(const T &elem) : next(nullptr), elem_(elem) {}
+    };
+
+    struct Retired_ {
+        Node *node;
+        uint64_t epoch;
+    };
+
+public:
+    explicit RcuList(const Allocator &alloc = Allocator());
+    ~RcuList();
+
+    RcuList(const RcuList &) = delete;
+    RcuList &operator=(const RcuList &) = delete;
+
+    size_t size() const;
+    bool empty() const;
+
+    // читатели
+    template <typename Function>
+    void for_each(Function f) const;
+    template <typename Predicate>
+    bool find_if(Predicate pred, T &out) const;
+    template <typename Predicate>
+    bool any_of(Predicate pred) const;
+
+    // писатели
+    void push_front(const T &value);
+    void push_back(const T &value);
+    template <typename Predicate>
+    size_t erase_if(Predicate pred);
+    template <typename Predicate, typename Function>
+    size_t update_if(Predicate pred, Function f);
+    void clear();
+
+    void synchronize();
+    size_t retired() const;
+
+    Allocator get_allocator() const;
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    static const size_t reclaim_batch_ = 64;
+
+    Node *new_node_(const T &value);
+    void free_node_(Node *);
+    void retire_(Node *);
+    void reclaim_();
+
+    node_allocator_type_ node_allocator_;
+
+    std::atomic<Node *> head_{nullptr};
+    std::atomic<size_t> size_{0};
+
+    // дальше все только для писателей, под mutex_
+    mutable std::mutex mutex_;
+    Node *tail_ = nullptr;
+    std::vector<Retired_> retired_;
+};
+
+template <typename T, typename Allocator>
+RcuList<T, Allocator>::RcuList(const Allocator &alloc)
+        : node_allocator_(alloc) {}
+
+/*
+ *  К моменту разрушения читателей быть уже не должно
+ */
+template <typename T, typename Allocator>
+RcuList<T, Allocator>::~RcuList() {
+    Node *node = head_.load(std::memory_order_relaxed);
+    while (node) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        free_node_(node);
+        node = next;
+    }
+    for (size_t i = 0; i < retired_.size(); i++) {
+        free_node_(retired_[i].node);
+    }
+}
+
+template <typename T, typename Allocator>
+size_t RcuList<T, Allocator>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator>
+bool RcuList<T, Allocator>::empty() const {
+    return size() == 0;
+}
+
+template <typename T, typename Allocator>
+template <typename Function>
+void RcuList<T, Allocator>::for_each(Function f) const {
+    EpochGuard guard;
+    for (Node *node = head_.load(std::memory_order_acquire); node;
+         node = node->next.load(std::memory_order_acquire)) {
+        f(static_cast<const T &>(node->elem_));
+    }
+}
+
+/*
+ *  Ссылку наружу отдавать нельзя (узел могут освободить после выхода из
+ * секции), поэтому найденное копируется в out
+ */
+template <typename T, typename Allocator>
+template <typename Predicate>
+bool RcuList<T, Allocator>::find_if(Predicate pred, T &out) const {
+    EpochGuard guard;
+    for (Node *node = head_.load(std::memory_order_acquire); node;
+         node = node->next.load(std::memory_order_acquire)) {
+        if (pred(static_cast<const T &>(node->elem_))) {
+            out = node->elem_;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, typename Allocator>
+template <typename Predicate>
+bool RcuList<T, Allocator>::any_of(Predicate pred) const {
+    EpochGuard guard;
+    for (Node *node = head_.load(std::memory_order_acquire); node;
+         node = node->next.load(std::memory_order_acquire)) {
+        if (pred(static_cast<const T &>(node->elem_))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, typename Allocator>
+typename RcuList<T, Allocator>::Node *RcuList<T, Allocator>::new_node_(
+    const T &value) {
+    Node *node = node_allocator_traits_::allocate(node_allocator_, 1);
+    try {
+        node_allocator_traits_::construct(node_allocator_, node, value);
+    } catch (...) {
+        node_allocator_traits_::deallocate(node_allocator_, node, 1);
+        throw;
+    }
+    return node;
+}
+
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::free_node_(Node *node) {
+    node_allocator_traits_::destroy(node_allocator_, node);
+    node_allocator_traits_::deallocate(node_allocator_, node, 1);
+}
+
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::push_front(const T &value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Node *node = new_node_(value);
+    Node *head = head_.load(std::memory_order_relaxed);
+    node->next.store(head, std::memory_order_relaxed);
+    head_.store(node, std::memory_order_release);
+
+    if (head == nullptr) {
+        tail_ = node;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::push_back(const T &value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Node *node = new_node_(value);
+    if (tail_) {
+        tail_->next.store(node, std::memory_order_release);
+    } else {
+        head_.store(node, std::memory_order_release);
+    }
+    tail_ = node;
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ *  Выкидываем узлы, подходящие под pred
+ *  У выкинутого узла next не трогаем: читатель, который сейчас на нем
+ * стоит, должен суметь дойти до конца
+ */
+template <typename T, typename Allocator>
+template <typename Predicate>
+size_t RcuList<T, Allocator>::erase_if(Predicate pred) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t erased = 0;
+    std::atomic<Node *> *link = &head_;
+    Node *prev = nullptr;
+    Node *node = head_.load(std::memory_order_relaxed);
+
+    while (node) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        if (pred(static_cast<const T &>(node->elem_))) {
+            link->store(next, std::memory_order_release);
+            if (tail_ == node) {
+                tail_ = prev;
+            }
+            retire_(node);
+            ++erased;
+        } else {
+            link = &node->next;
+            prev = node;
+        }
+        node = next;
+    }
+
+    size_.fetch_sub(erased, std::memory_order_relaxed);
+    if (retired_.size() >= reclaim_batch_) {
+        reclaim_();
+    }
+    return erased;
+}
+
+/*
+ *  Копия узла, f меняет копию, копия встает на место старого узла
+ */
+template <typename T, typename Allocator>
+template <typename Predicate, typename Function>
+size_t RcuList<T, Allocator>::update_if(Predicate pred, Function f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t updated = 0;
+    std::atomic<Node *> *link = &head_;
+    Node *node = head_.load(std::memory_order_relaxed);
+
+    while (node) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        if (pred(static_cast<const T &>(node->elem_))) {
+            Node *copy = new_node_(node->elem_);
+            try {
+                f(copy->elem_);
+            } catch (...) {
+                free_node_(copy);
+                throw;
+            }
+
+            copy->next.store(next, std::memory_order_relaxed);
+            link->store(copy, std::memory_order_release);
+            if (tail_ == node) {
+                tail_ = copy;
+            }
+            retire_(node);
+            link = &copy->next;
+            ++updated;
+        } else {
+            link = &node->next;
+        }
+        node = next;
+    }
+
+    if (retired_.size() >= reclaim_batch_) {
+        reclaim_();
+    }
+    return updated;
+}
+
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Node *node = head_.exchange(nullptr, std::memory_order_acq_rel);
+    tail_ = nullptr;
+    size_.store(0, std::memory_order_relaxed);
+
+    while (node) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        retire_(node);
+        node = next;
+    }
+    reclaim_();
+}
+
+/*
+ *  Эпоха читается после того, как узел выкинут: кто вошел с эпохой не
+ * меньше этой, узел уже не найдет
+ */
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::retire_(Node *node) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    retired_.push_back(Retired_{node, EpochDomain::getEpochDomain()->current()});
+}
+
+/*
+ *  Сдвигаем эпоху и освобождаем пачкой все, что старше самого старого
+ * читателя. Остальное ждет следующего раза
+ */
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::reclaim_() {
+    EpochDomain *domain = EpochDomain::getEpochDomain();
+    domain->advance();
+    uint64_t safe = domain->min_active();
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); i++) {
+        if (retired_[i].epoch < safe) {
+            free_node_(retired_[i].node);
+        } else {
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+}
+
+/*
+ *  Ждет, пока освободится все выкинутое (аналог synchronize_rcu)
+ *  Из критической секции читателя звать нельзя - не дождется
+ */
+template <typename T, typename Allocator>
+void RcuList<T, Allocator>::synchronize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    reclaim_();
+    while (!retired_.empty()) {
+        std::this_thread::yield();
+        reclaim_();
+    }
+}
+
+template <typename T, typename Allocator>
+size_t RcuList<T, Allocator>::retired() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retired_.size();
+}
+
+template <typename T, typename Allocator>
+Allocator RcuList<T, Allocator>::get_allocator() const {
+    return Allocator(node_allocator_);
+}
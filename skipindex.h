@@ -0,0 +1,562 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ *
+ *      SkipIndexList<T, Allocator>
+ *
+ *      List плюс индекс поверх него в виде башен skip list'а с ширинами
+ * ребер (сколько элементов листа ребро перепрыгивает)
+ *
+ *      - at(k) за O(log n + stride)
+ *      - lower_bound / upper_bound / insert_sorted на отсортированном листе
+ *      - split_points для параллельных алгоритмов (parallellist.h) без
+ * прохода по всему листу
+ *
+ *      В первый уровень индекса попадает примерно каждый stride-й элемент,
+ * в каждый следующий - каждый четвертый из предыдущего. Чем больше stride,
+ * тем меньше памяти на индекс, но тем дольше идти по листу в конце поиска
+ *
+ *      Узлы индекса выделяются тем же Allocator (с FastAllocator - из
+ * FixedAllocator), а менять лист можно только через методы этого класса,
+ * иначе индекс разъедется с листом
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct SkipIndexList {
+public:
+    typedef List<T, Allocator> list_type;
+    typedef typename list_type::iterator iterator;
+    typedef typename list_type::const_iterator const_iterator;
+
+    explicit SkipIndexList(size_t stride = 8,
+                           const Allocator &alloc = Allocator());
+    explicit SkipIndexList(const list_type &list, size_t stride = 8);
+    SkipIndexList(const SkipIndexList &rhs);
+    SkipIndexList &operator=(const SkipIndexList &rhs);
+    ~SkipIndexList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    size_t stride() const;
+    size_t index_nodes() const;
+
+    const list_type &list() const;
+
+    iterator begin() const;
+    iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    iterator at(size_t) const;
+
+    iterator insert_at(size_t, const T &);
+    iterator erase_at(size_t);
+
+    void push_front(const T &value);
+    void push_back(const T &value);
+    void pop_front();
+    void pop_back();
+
+    template <typename Compare = std::less<T> >
+    iterator lower_bound(const T &, Compare comp = Compare()) const;
+    template <typename Compare = std::less<T> >
+    iterator upper_bound(const T &, Compare comp = Compare()) const;
+    template <typename Compare = std::less<T> >
+    iterator insert_sorted(const T &, Compare comp = Compare());
+    template <typename Compare = std::less<T> >
+    bool erase_sorted(const T &, Compare comp = Compare());
+
+    std::vector<iterator> split_points(size_t parts) const;
+
+private:
+    /*
+     *  Узел одного уровня башни
+     *  width - на сколько позиций вперед указывает next (если next нет -
+     * до позиции size + 1, как будто там стоит сентинел)
+     *  Позиции считаем с единицы, позиция 0 - голова
+     */
+    struct Level {
+        Level *next;
+        Level *down;
+        size_t width;
+        iterator elem;
+    };
+
+    using level_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Level>;
+    using level_allocator_traits_ = std::allocator_traits<level_allocator_type_>;
+
+    Level *new_level_(Level *next, Level *down, size_t width, iterator elem);
+    void delete_level_(Level *);
+
+    size_t random_height_();
+    void ensure_levels_(size_t);
+    void clear_index_();
+    void rebuild_();
+
+    template <typename Less>
+    size_t rank_(Less less) const;
+
+    iterator walk_(const Level *, size_t position, size_t steps) const;
+
+    list_type list_;
+    level_allocator_type_ level_allocator_;
+    size_t stride_;
+    size_t index_nodes_ = 0;
+    uint64_t random_state_ = 0x9e3779b97f4a7c15ull;
+
+    // heads_[l] - голова уровня l + 1, heads_.back() - самый верхний
+    std::vector<Level *> heads_;
+};
+
+template <typename T, typename Allocator>
+SkipIndexList<T, Allocator>::SkipIndexList(size_t stride,
+                                           const Allocator &alloc)
+        : list_(alloc), stride_(stride < 2 ? 2 : stride) {}
+
+template <typename T, typename Allocator>
+SkipIndexList<T, Allocator>::SkipIndexList(const list_type &list,
+                                           size_t stride)
+        : list_(list), stride_(stride < 2 ? 2 : stride) {
+    rebuild_();
+}
+
+template <typename T, typename Allocator>
+SkipIndexList<T, Allocator>::SkipIndexList(const SkipIndexList &rhs)
+        : list_(rhs.list_), stride_(rhs.stride_) {
+    rebuild_();
+}
+
+template <typename T, typename Allocator>
+SkipIndexList<T, Allocator> &SkipIndexList<T, Allocator>::operator=(
+    const SkipIndexList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    list_ = rhs.list_;
+    stride_ = rhs.stride_;
+    rebuild_();
+
+    return *this;
+}
+
+template <typename T, typename Allocator>
+SkipIndexList<T, Allocator>::~SkipIndexList() {
+    clear_index_();
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::Level *
+SkipIndexList<T, Allocator>::new_level_(Level *next, Level *down, size_t width,
+                                        iterator elem) {
+    Level *level = level_allocator_traits_::allocate(level_allocator_, 1);
+    level_allocator_traits_::construct(level_allocator_, level,
+                                       Level{next, down, width, elem});
+    ++index_nodes_;
+    return level;
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::delete_level_(Level *level) {
+    level_allocator_traits_::destroy(level_allocator_, level);
+    level_allocator_traits_::deallocate(level_allocator_, level, 1);
+    --index_nodes_;
+}
+
+/*
+ *  0 - элемент только в листе, 1 - есть в первом уровне, и т.д.
+ */
+template <typename T, typename Allocator>
+size_t SkipIndexList<T, Allocator>::random_height_() {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 7;
+    random_state_ ^= random_state_ << 17;
+
+    uint64_t bits = random_state_;
+    if (bits % stride_ != 0) {
+        return 0;
+    }
+    bits /= stride_;
+
+    size_t height = 1;
+    while ((bits & 3) == 0 && height < 32) {
+        bits >>= 2;
+        ++height;
+    }
+    return height;
+}
+
+/*
+ *  Новый верхний уровень пока пустой: голова смотрит сразу в конец
+ */
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::ensure_levels_(size_t height) {
+    while (heads_.size() < height) {
+        Level *down = heads_.empty() ? nullptr : heads_.back();
+        heads_.push_back(new_level_(nullptr, down, list_.size() + 1, iterator()));
+    }
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::clear_index_() {
+    for (size_t l = 0; l < heads_.size(); l++) {
+        Level *level = heads_[l];
+        while (level) {
+            Level *next = level->next;
+            delete_level_(level);
+            level = next;
+        }
+    }
+    heads_.clear();
+}
+
+/*
+ *  Строим индекс заново за один проход по листу
+ */
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::rebuild_() {
+    clear_index_();
+
+    std::vector<Level *> last;
+    std::vector<size_t> last_position;
+
+    size_t position = 1;
+    for (iterator it = list_.begin(); it != list_.end(); ++it, ++position) {
+        size_t height = random_height_();
+        ensure_levels_(height);
+        while (last.size() < heads_.size()) {
+            last.push_back(heads_[last.size()]);
+            last_position.push_back(0);
+        }
+
+        Level *down = nullptr;
+        for (size_t l = 0; l < height; l++) {
+            Level *level = new_level_(nullptr, down, 0, it);
+            last[l]->next = level;
+            last[l]->width = position - last_position[l];
+            last[l] = level;
+            last_position[l] = position;
+            down = level;
+        }
+    }
+
+    for (size_t l = 0; l < last.size(); l++) {
+        last[l]->width = list_.size() + 1 - last_position[l];
+    }
+}
+
+template <typename T, typename Allocator>
+size_t SkipIndexList<T, Allocator>::size() const {
+    return list_.size();
+}
+
+template <typename T, typename Allocator>
+bool SkipIndexList<T, Allocator>::empty() const {
+    return list_.empty();
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::clear() {
+    clear_index_();
+    list_.clear();
+}
+
+template <typename T, typename Allocator>
+size_t SkipIndexList<T, Allocator>::stride() const {
+    return stride_;
+}
+
+template <typename T, typename Allocator>
+size_t SkipIndexList<T, Allocator>::index_nodes() const {
+    return index_nodes_;
+}
+
+template <typename T, typename Allocator>
+const typename SkipIndexList<T, Allocator>::list_type &
+SkipIndexList<T, Allocator>::list() const {
+    return list_;
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::begin() const {
+    return list_.begin();
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::end() const {
+    return list_.end();
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::const_iterator
+SkipIndexList<T, Allocator>::cbegin() const {
+    return list_.cbegin();
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::const_iterator
+SkipIndexList<T, Allocator>::cend() const {
+    return list_.cend();
+}
+
+/*
+ *  Дойти по листу от узла индекса level (он стоит на позиции position)
+ * еще на steps позиций вперед
+ */
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::walk_(const Level *level, size_t position,
+                                   size_t steps) const {
+    iterator it;
+    if (position == 0 || level == nullptr) {
+        it = list_.begin();
+        --steps;
+    } else {
+        it = level->elem;
+    }
+
+    for (size_t i = 0; i < steps; i++) {
+        ++it;
+    }
+    return it;
+}
+
+/*
+ *  k-й элемент (с нуля), для k == size() - end()
+ */
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator SkipIndexList<T, Allocator>::at(
+    size_t index) const {
+    size_t target = index + 1;
+    size_t position = 0;
+    const Level *level = heads_.empty() ? nullptr : heads_.back();
+    const Level *bottom = nullptr;
+
+    while (level) {
+        while (level->next && position + level->width <= target) {
+            position += level->width;
+            level = level->next;
+        }
+        bottom = level;
+        level = level->down;
+    }
+
+    return walk_(bottom, position, target - position);
+}
+
+/*
+ *  Вставка так, чтобы новый элемент оказался k-м
+ *  Спускаясь, запоминаем на каждом уровне последний узел перед новой
+ * позицией: у него либо появится новый сосед, либо ребро станет шире на 1
+ */
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::insert_at(size_t index, const T &value) {
+    size_t height = random_height_();
+    ensure_levels_(height);
+
+    size_t target = index + 1;
+    std::vector<Level *> update(heads_.size());
+    std::vector<size_t> update_position(heads_.size());
+
+    size_t position = 0;
+    Level *level = heads_.empty() ? nullptr : heads_.back();
+    for (size_t l = heads_.size(); l > 0; l--) {
+        while (level->next && position + level->width < target) {
+            position += level->width;
+            level = level->next;
+        }
+        update[l - 1] = level;
+        update_position[l - 1] = position;
+        level = level->down;
+    }
+
+    iterator before = heads_.empty()
+        ? at(index)
+        : walk_(update[0], update_position[0], target - update_position[0]);
+    iterator it = list_.insert(before, value);
+
+    Level *down = nullptr;
+    for (size_t l = 0; l < heads_.size(); l++) {
+        Level *prev = update[l];
+        if (l < height) {
+            size_t width = prev->width + update_position[l] + 1 - target;
+            Level *newbie = new_level_(prev->next, down, width, it);
+            prev->next = newbie;
+            prev->width = target - update_position[l];
+            down = newbie;
+        } else {
+            prev->width += 1;
+        }
+    }
+
+    return it;
+}
+
+template <typename T, typename Allocator>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::erase_at(size_t index) {
+    size_t target = index + 1;
+
+    size_t position = 0;
+    Level *level = heads_.empty() ? nullptr : heads_.back();
+    Level *bottom = nullptr;
+    size_t bottom_position = 0;
+
+    for (size_t l = heads_.size(); l > 0; l--) {
+        while (level->next && position + level->width < target) {
+            position += level->width;
+            level = level->next;
+        }
+
+        if (level->next && position + level->width == target) {
+            Level *victim = level->next;
+            level->width += victim->width - 1;
+            level->next = victim->next;
+            delete_level_(victim);
+        } else {
+            level->width -= 1;
+        }
+
+        bottom = level;
+        bottom_position = position;
+        level = level->down;
+    }
+
+    iterator it = walk_(bottom, bottom_position, target - bottom_position);
+    return list_.erase(it);
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::push_front(const T &value) {
+    insert_at(0, value);
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::push_back(const T &value) {
+    insert_at(list_.size(), value);
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::pop_front() {
+    if (!list_.empty()) {
+        erase_at(0);
+    }
+}
+
+template <typename T, typename Allocator>
+void SkipIndexList<T, Allocator>::pop_back() {
+    if (!list_.empty()) {
+        erase_at(list_.size() - 1);
+    }
+}
+
+/*
+ *  Число элементов, для которых less(x) истинно (лист отсортирован, так
+ * что это префикс)
+ */
+template <typename T, typename Allocator>
+template <typename Less>
+size_t SkipIndexList<T, Allocator>::rank_(Less less) const {
+    size_t position = 0;
+    const Level *level = heads_.empty() ? nullptr : heads_.back();
+    const Level *bottom = nullptr;
+
+    while (level) {
+        while (level->next && less(*level->next->elem)) {
+            position += level->width;
+            level = level->next;
+        }
+        bottom = level;
+        level = level->down;
+    }
+
+    iterator it = (position == 0 || bottom == nullptr) ? list_.begin()
+                                                       : std::next(bottom->elem);
+    for (; it != list_.end() && less(*it); ++it) {
+        ++position;
+    }
+    return position;
+}
+
+template <typename T, typename Allocator>
+template <typename Compare>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::lower_bound(const T &value, Compare comp) const {
+    return at(rank_([&](const T &x) { return comp(x, value); }));
+}
+
+template <typename T, typename Allocator>
+template <typename Compare>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::upper_bound(const T &value, Compare comp) const {
+    return at(rank_([&](const T &x) { return !comp(value, x); }));
+}
+
+/*
+ *  Вставка после всех равных элементов
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+typename SkipIndexList<T, Allocator>::iterator
+SkipIndexList<T, Allocator>::insert_sorted(const T &value, Compare comp) {
+    return insert_at(rank_([&](const T &x) { return !comp(value, x); }), value);
+}
+
+/*
+ *  Удаляет один элемент, равный value, если он есть
+ */
+template <typename T, typename Allocator>
+template <typename Compare>
+bool SkipIndexList<T, Allocator>::erase_sorted(const T &value, Compare comp) {
+    size_t rank = rank_([&](const T &x) { return comp(x, value); });
+    if (rank == list_.size() || comp(value, *at(rank))) {
+        return false;
+    }
+
+    erase_at(rank);
+    return true;
+}
+
+/*
+ *  Границы parts примерно равных кусков, формат как у split_points из
+ * parallellist.h: parts + 1 итератор, последний - end()
+ */
+template <typename T, typename Allocator>
+std::vector<typename SkipIndexList<T, Allocator>::iterator>
+SkipIndexList<T, Allocator>::split_points(size_t parts) const {
+    size_t count = list_.size();
+    if (parts > count) {
+        parts = count;
+    }
+    if (parts == 0) {
+        parts = 1;
+    }
+
+    std::vector<iterator> points;
+    points.reserve(parts + 1);
+
+    size_t chunk = count / parts;
+    size_t extra = count % parts;
+    size_t position = 0;
+    for (size_t k = 0; k < parts; k++) {
+        points.push_back(at(position));
+        position += chunk + (k < extra ? 1 : 0);
+    }
+    points.push_back(list_.end());
+
+    return points;
+}
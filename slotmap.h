@@ -0,0 +1,356 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+ *
+ *      SlotMap<T, Allocator>
+ *
+ *      Контейнер, который на вставку выдает ручку (handle) - 64 бита:
+ * номер слота в младших 32 битах и поколение слота в старших. Ручка не
+ * портится, когда удаляют или добавляют другие элементы, а ручка на уже
+ * удаленный элемент просто не находится (get вернет nullptr), вместо
+ * того чтобы, как итератор List, тихо портить память
+ *
+ *      Внутри три массива:
+ *      - dense_ - сами значения подряд, без дырок: по ним обход
+ *      - dense_slots_ - для каждого значения номер его слота
+ *      - slots_ - по номеру слота: где значение лежит в dense_ и поколение
+ *      При удалении последнее значение переезжает на место удаленного,
+ * поколение слота увеличивается, слот уходит в список свободных. Так что
+ * insert, erase и get - O(1)
+ *
+ *      Массивы выделяются через Allocator. FastAllocator тут ничего не
+ * дает: в пулы он отправляет только одиночные объекты, а массивы
+ * берет через ::operator new
+ *
+ *      Указатели на значения и обход (begin/end) портятся при вставке и
+ * удалении, ручки - нет
+ *
+ */
+
+template <typename T, typename Allocator = std::allocator<T> >
+struct SlotMap {
+    typedef uint64_t handle_type;
+
+    // ни одна ручка не бывает равна null_handle
+    static const handle_type null_handle = 0;
+
+    typedef typename std::vector<T, Allocator>::iterator iterator;
+    typedef typename std::vector<T, Allocator>::const_iterator const_iterator;
+
+    explicit SlotMap(const Allocator &alloc = Allocator());
+
+    handle_type insert(const T &value);
+    handle_type insert(T &&value);
+    template <typename... Args>
+    handle_type emplace(Args &&... args);
+
+    bool erase(handle_type handle);
+    void clear();
+
+    T *get(handle_type handle);
+    const T *get(handle_type handle) const;
+    T &at(handle_type handle);
+    const T &at(handle_type handle) const;
+    bool contains(handle_type handle) const;
+
+    // ручка значения, которое лежит на месте pos при обходе
+    handle_type handle_at(size_t pos) const;
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    size_t size() const;
+    bool empty() const;
+    void reserve(size_t count);
+
+    Allocator get_allocator() const;
+
+private:
+    typedef uint32_t index_type;
+
+    // free_end_ - конец списка свободных слотов
+    static const index_type free_end_ = static_cast<index_type>(-1);
+
+    struct Slot_ {
+        // для занятого слота - место в dense_, для свободного - следующий
+        // свободный
+        index_type index;
+        index_type generation;
+    };
+
+    using index_allocator_type_ = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<index_type>;
+    using slot_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Slot_>;
+
+    static handle_type make_handle_(index_type slot, index_type generation);
+    static index_type slot_of_(handle_type handle);
+    static index_type generation_of_(handle_type handle);
+
+    const Slot_ *find_(handle_type handle) const;
+    index_type acquire_();
+    handle_type commit_(index_type slot);
+
+    std::vector<T, Allocator> dense_;
+    std::vector<index_type, index_allocator_type_> dense_slots_;
+    std::vector<Slot_, slot_allocator_type_> slots_;
+    index_type free_ = free_end_;
+};
+
+template <typename T, typename Allocator>
+const typename SlotMap<T, Allocator>::handle_type
+    SlotMap<T, Allocator>::null_handle;
+
+template <typename T, typename Allocator>
+const typename SlotMap<T, Allocator>::index_type
+    SlotMap<T, Allocator>::free_end_;
+
+template <typename T, typename Allocator>
+SlotMap<T, Allocator>::SlotMap(const Allocator &alloc)
+        : dense_(alloc),
+          dense_slots_(index_allocator_type_(alloc)),
+          slots_(slot_allocator_type_(alloc)) {}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::handle_type
+SlotMap<T, Allocator>::make_handle_(index_type slot, index_type generation) {
+    return (static_cast<handle_type>(generation) << 32) | slot;
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::index_type
+SlotMap<T, Allocator>::slot_of_(handle_type handle) {
+    return static_cast<index_type>(handle);
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::index_type
+SlotMap<T, Allocator>::generation_of_(handle_type handle) {
+    return static_cast<index_type>(handle >> 32);
+}
+
+/*
+ *  Поколение в ручке должно совпасть с поколением слота: после erase
+ * поколение слота уже другое. Живых поколений 0 не бывает (начинаем с 1,
+ * а дошедший до 0 слот списан), поэтому null_handle не находится никогда
+ */
+template <typename T, typename Allocator>
+const typename SlotMap<T, Allocator>::Slot_ *
+SlotMap<T, Allocator>::find_(handle_type handle) const {
+    index_type slot = slot_of_(handle);
+    if (slot >= slots_.size() || generation_of_(handle) == 0) {
+        return nullptr;
+    }
+    const Slot_ &entry = slots_[slot];
+    if (entry.generation != generation_of_(handle)) {
+        return nullptr;
+    }
+    return &entry;
+}
+
+/*
+ *  Слот из списка свободных или новый. В список он попадет обратно,
+ * только если значение не удастся положить в dense_
+ */
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::index_type SlotMap<T, Allocator>::acquire_() {
+    if (free_ != free_end_) {
+        index_type slot = free_;
+        free_ = slots_[slot].index;
+        return slot;
+    }
+
+    if (slots_.size() >= free_end_) {
+        throw std::length_error("SlotMap is limited to 2^32 - 1 slots");
+    }
+    slots_.push_back(Slot_{free_end_, 1});
+    return static_cast<index_type>(slots_.size() - 1);
+}
+
+/*
+ *  Значение уже в конце dense_, осталось связать его со слотом
+ */
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::handle_type
+SlotMap<T, Allocator>::commit_(index_type slot) {
+    try {
+        dense_slots_.push_back(slot);
+    } catch (...) {
+        dense_.pop_back();
+        slots_[slot].index = free_;
+        free_ = slot;
+        throw;
+    }
+
+    slots_[slot].index = static_cast<index_type>(dense_.size() - 1);
+    return make_handle_(slot, slots_[slot].generation);
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::handle_type SlotMap<T, Allocator>::insert(
+    const T &value) {
+    return emplace(value);
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::handle_type SlotMap<T, Allocator>::insert(
+    T &&value) {
+    return emplace(std::move(value));
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+typename SlotMap<T, Allocator>::handle_type SlotMap<T, Allocator>::emplace(
+    Args &&... args) {
+    index_type slot = acquire_();
+    try {
+        dense_.emplace_back(std::forward<Args>(args)...);
+    } catch (...) {
+        slots_[slot].index = free_;
+        free_ = slot;
+        throw;
+    }
+    return commit_(slot);
+}
+
+/*
+ *  На место удаленного переезжает последнее значение, его слот
+ * перенаправляем. Поколение слота растет, так что все старые ручки на
+ * него протухают. Слот, у которого поколение кончилось (прошло 2^32 - 1
+ * удалений), больше не выдаем, иначе старые ручки ожили бы
+ */
+template <typename T, typename Allocator>
+bool SlotMap<T, Allocator>::erase(handle_type handle) {
+    if (find_(handle) == nullptr) {
+        return false;
+    }
+
+    index_type slot = slot_of_(handle);
+    index_type pos = slots_[slot].index;
+    index_type last = static_cast<index_type>(dense_.size() - 1);
+
+    if (pos != last) {
+        dense_[pos] = std::move(dense_[last]);
+        dense_slots_[pos] = dense_slots_[last];
+        slots_[dense_slots_[pos]].index = pos;
+    }
+    dense_.pop_back();
+    dense_slots_.pop_back();
+
+    Slot_ &entry = slots_[slot];
+    if (++entry.generation != 0) {
+        entry.index = free_;
+        free_ = slot;
+    }
+    return true;
+}
+
+/*
+ *  Все слоты становятся свободными, все выданные ручки протухают
+ */
+template <typename T, typename Allocator>
+void SlotMap<T, Allocator>::clear() {
+    for (size_t i = 0; i < dense_slots_.size(); i++) {
+        Slot_ &entry = slots_[dense_slots_[i]];
+        if (++entry.generation != 0) {
+            entry.index = free_;
+            free_ = dense_slots_[i];
+        }
+    }
+    dense_.clear();
+    dense_slots_.clear();
+}
+
+template <typename T, typename Allocator>
+T *SlotMap<T, Allocator>::get(handle_type handle) {
+    const Slot_ *entry = find_(handle);
+    return entry ? &dense_[entry->index] : nullptr;
+}
+
+template <typename T, typename Allocator>
+const T *SlotMap<T, Allocator>::get(handle_type handle) const {
+    const Slot_ *entry = find_(handle);
+    return entry ? &dense_[entry->index] : nullptr;
+}
+
+template <typename T, typename Allocator>
+T &SlotMap<T, Allocator>::at(handle_type handle) {
+    T *value = get(handle);
+    if (value == nullptr) {
+        throw std::out_of_range("SlotMap::at");
+    }
+    return *value;
+}
+
+template <typename T, typename Allocator>
+const T &SlotMap<T, Allocator>::at(handle_type handle) const {
+    const T *value = get(handle);
+    if (value == nullptr) {
+        throw std::out_of_range("SlotMap::at");
+    }
+    return *value;
+}
+
+template <typename T, typename Allocator>
+bool SlotMap<T, Allocator>::contains(handle_type handle) const {
+    return find_(handle) != nullptr;
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::handle_type SlotMap<T, Allocator>::handle_at(
+    size_t pos) const {
+    index_type slot = dense_slots_[pos];
+    return make_handle_(slot, slots_[slot].generation);
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::iterator SlotMap<T, Allocator>::begin() {
+    return dense_.begin();
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::iterator SlotMap<T, Allocator>::end() {
+    return dense_.end();
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::const_iterator SlotMap<T, Allocator>::begin()
+    const {
+    return dense_.begin();
+}
+
+template <typename T, typename Allocator>
+typename SlotMap<T, Allocator>::const_iterator SlotMap<T, Allocator>::end()
+    const {
+    return dense_.end();
+}
+
+template <typename T, typename Allocator>
+size_t SlotMap<T, Allocator>::size() const {
+    return dense_.size();
+}
+
+template <typename T, typename Allocator>
+bool SlotMap<T, Allocator>::empty() const {
+    return dense_.empty();
+}
+
+template <typename T, typename Allocator>
+void SlotMap<T, Allocator>::reserve(size_t count) {
+    dense_.reserve(count);
+    dense_slots_.reserve(count);
+    slots_.reserve(count);
+}
+
+template <typename T, typename Allocator>
+Allocator SlotMap<T, Allocator>::get_allocator() const {
+    return dense_.get_allocator();
+}
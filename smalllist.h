@@ -0,0 +1,438 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+/*
+ *
+ *      SmallList<T, N, Allocator>
+ *
+ *      Двусвязный список, у которого первые N узлов лежат прямо внутри
+ * объекта списка. Пока элементов не больше N, аллокатор не вызывается
+ * вообще, а дальше узлы берутся из Allocator, как в List
+ *
+ *      Освободившиеся встроенные узлы переиспользуются в первую очередь
+ *      Узлы никуда не переезжают, так что итераторы стабильны так же, как
+ * у List (но встроенные узлы, конечно, живут не дольше самого списка)
+ *
+ */
+
+template <typename T, size_t N = 8, typename Allocator = std::allocator<T> >
+struct SmallList {
+private:
+    struct NodeBase {
+        NodeBase *next;
+        NodeBase *prev;
+    };
+
+    struct Node : NodeBase {
+        T elem_;
+        Node(const T &value) : elem_(value) {}
+    };
+
+public:
+    explicit SmallList(const Allocator &alloc = Allocator());
+    SmallList(size_t count, const T &value,
+              const Allocator &alloc = Allocator());
+    SmallList(size_t count);
+    SmallList(const SmallList &rhs);
+    SmallList &operator=(const SmallList &rhs);
+    ~SmallList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    static size_t inline_capacity();
+
+    void pop_front();
+    void pop_back();
+
+    void push_front(const T &value);
+    void push_back(const T &value);
+
+    Allocator &get_allocator();
+
+    template <typename U>
+    class small_iterator;
+
+    typedef small_iterator<T> iterator;
+    typedef small_iterator<T const> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    iterator insert(const_iterator, const T &);
+    iterator erase(const_iterator);
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    Node *allocate_node_();
+    void deallocate_node_(Node *);
+    bool is_inline_(Node *) const;
+
+    void copy_(const SmallList &);
+
+    Allocator allocator_;
+    node_allocator_type_ node_allocator_;
+    size_t size_ = 0;
+
+    // сентинел тоже внутри, закольцован
+    mutable NodeBase head_;
+
+    // свободные встроенные узлы, связаны через next
+    NodeBase *inline_free_ = nullptr;
+    typename std::aligned_storage<sizeof(Node), alignof(Node)>::type inline_[N];
+};
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator>::SmallList(const Allocator &alloc)
+        : allocator_(std::allocator_traits<Allocator>::
+                         select_on_container_copy_construction(alloc)) {
+    head_.next = head_.prev = &head_;
+
+    for (size_t i = N; i > 0; i--) {
+        NodeBase *slot = reinterpret_cast<NodeBase *>(&inline_[i - 1]);
+        slot->next = inline_free_;
+        inline_free_ = slot;
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator>::SmallList(size_t count, const T &value,
+                                      const Allocator &alloc)
+        : SmallList(alloc) {
+    for (size_t i = 0; i < count; i++) {
+        push_back(value);
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator>::SmallList(size_t count)
+        : SmallList(Allocator()) {
+    for (size_t i = 0; i < count; i++) {
+        push_back(T());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator>::SmallList(const SmallList &rhs)
+        : SmallList(rhs.allocator_) {
+    copy_(rhs);
+}
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator> &SmallList<T, N, Allocator>::operator=(
+    const SmallList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+
+    if (std::allocator_traits<Allocator>::
+            propagate_on_container_copy_assignment::value) {
+        allocator_ = rhs.allocator_;
+    }
+
+    copy_(rhs);
+
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+SmallList<T, N, Allocator>::~SmallList() {
+    clear();
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::copy_(const SmallList &rhs) {
+    for (auto it = rhs.cbegin(); it != rhs.cend(); ++it) {
+        push_back(*it);
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+size_t SmallList<T, N, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, size_t N, typename Allocator>
+bool SmallList<T, N, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::clear() {
+    while (size_ > 0) {
+        pop_back();
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+size_t SmallList<T, N, Allocator>::inline_capacity() {
+    return N;
+}
+
+template <typename T, size_t N, typename Allocator>
+bool SmallList<T, N, Allocator>::is_inline_(Node *ptr) const {
+    const void *first = &inline_[0];
+    const void *last = &inline_[N];
+    return !std::less<const void *>()(ptr, first) &&
+           std::less<const void *>()(ptr, last);
+}
+
+/*
+ *  Сначала встроенные узлы, и только если их нет - аллокатор
+ */
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::Node *
+SmallList<T, N, Allocator>::allocate_node_() {
+    if (inline_free_) {
+        NodeBase *slot = inline_free_;
+        inline_free_ = slot->next;
+        return reinterpret_cast<Node *>(slot);
+    }
+    return node_allocator_traits_::allocate(node_allocator_, 1);
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::deallocate_node_(Node *ptr) {
+    if (is_inline_(ptr)) {
+        NodeBase *slot = reinterpret_cast<NodeBase *>(ptr);
+        slot->next = inline_free_;
+        inline_free_ = slot;
+    } else {
+        node_allocator_traits_::deallocate(node_allocator_, ptr, 1);
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::pop_front() {
+    if (size_) {
+        erase(begin());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::pop_back() {
+    if (size_) {
+        erase(--end());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::push_front(const T &value) {
+    insert(begin(), value);
+}
+
+template <typename T, size_t N, typename Allocator>
+void SmallList<T, N, Allocator>::push_back(const T &value) {
+    insert(end(), value);
+}
+
+template <typename T, size_t N, typename Allocator>
+Allocator &SmallList<T, N, Allocator>::get_allocator() {
+    return allocator_;
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::iterator SmallList<T, N, Allocator>::insert(
+    const_iterator iter, const T &value) {
+    Node *newbie = allocate_node_();
+    node_allocator_traits_::construct(node_allocator_, newbie, value);
+
+    NodeBase *ptr = iter.ptr_;
+    newbie->next = ptr;
+    newbie->prev = ptr->prev;
+    ptr->prev->next = newbie;
+    ptr->prev = newbie;
+
+    ++size_;
+    return iterator(newbie);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::iterator SmallList<T, N, Allocator>::erase(
+    const_iterator iter) {
+    NodeBase *ptr = iter.ptr_;
+    iterator ret(ptr->next);
+
+    ptr->prev->next = ptr->next;
+    ptr->next->prev = ptr->prev;
+
+    Node *node = static_cast<Node *>(ptr);
+    node_allocator_traits_::destroy(node_allocator_, node);
+    deallocate_node_(node);
+
+    --size_;
+    return ret;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+class SmallList<T, N, Allocator>::small_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename std::remove_const<U>::type;
+    using pointer = U *;
+    using reference = U &;
+
+    small_iterator() = default;
+    small_iterator(const small_iterator<typename std::remove_const<T>::type> &rhs);
+    small_iterator &operator=(const small_iterator &rhs) = default;
+
+    U &operator*() const;
+    U *operator->() const;
+
+    small_iterator &operator++();
+    small_iterator operator++(int);
+    small_iterator &operator--();
+    small_iterator operator--(int);
+
+    bool operator==(const small_iterator<U> &rhs) const;
+    bool operator!=(const small_iterator<U> &rhs) const;
+    friend struct SmallList<T, N, Allocator>;
+    friend class small_iterator<T const>;
+
+private:
+    explicit small_iterator(NodeBase *ptr);
+
+    NodeBase *ptr_ = nullptr;
+};
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+SmallList<T, N, Allocator>::small_iterator<U>::small_iterator(NodeBase *ptr)
+        : ptr_(ptr) {}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+SmallList<T, N, Allocator>::small_iterator<U>::small_iterator(
+    const small_iterator<typename std::remove_const<T>::type> &rhs)
+        : ptr_(rhs.ptr_) {}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+U &SmallList<T, N, Allocator>::small_iterator<U>::operator*() const {
+    return static_cast<Node *>(ptr_)->elem_;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+U *SmallList<T, N, Allocator>::small_iterator<U>::operator->() const {
+    return &static_cast<Node *>(ptr_)->elem_;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename SmallList<T, N, Allocator>::template small_iterator<U> &
+SmallList<T, N, Allocator>::small_iterator<U>::operator++() {
+    ptr_ = ptr_->next;
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename SmallList<T, N, Allocator>::template small_iterator<U>
+SmallList<T, N, Allocator>::small_iterator<U>::operator++(int) {
+    small_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename SmallList<T, N, Allocator>::template small_iterator<U> &
+SmallList<T, N, Allocator>::small_iterator<U>::operator--() {
+    ptr_ = ptr_->prev;
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename SmallList<T, N, Allocator>::template small_iterator<U>
+SmallList<T, N, Allocator>::small_iterator<U>::operator--(int) {
+    small_iterator other = *this;
+    --(*this);
+    return other;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+bool SmallList<T, N, Allocator>::small_iterator<U>::operator==(
+    const small_iterator<U> &rhs) const {
+    return ptr_ == rhs.ptr_;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+bool SmallList<T, N, Allocator>::small_iterator<U>::operator!=(
+    const small_iterator<U> &rhs) const {
+    return ptr_ != rhs.ptr_;
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::iterator
+SmallList<T, N, Allocator>::begin() const {
+    return iterator(head_.next);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::const_iterator
+SmallList<T, N, Allocator>::cbegin() const {
+    return const_iterator(head_.next);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::iterator
+SmallList<T, N, Allocator>::end() const {
+    return iterator(&head_);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::const_iterator
+SmallList<T, N, Allocator>::cend() const {
+    return const_iterator(&head_);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::reverse_iterator
+SmallList<T, N, Allocator>::rbegin() const {
+    return reverse_iterator(end());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::const_reverse_iterator
+SmallList<T, N, Allocator>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::reverse_iterator
+SmallList<T, N, Allocator>::rend() const {
+    return reverse_iterator(begin());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename SmallList<T, N, Allocator>::const_reverse_iterator
+SmallList<T, N, Allocator>::crend() const {
+    return const_reverse_iterator(cbegin());
+}
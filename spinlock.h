@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+/*
+ *
+ *      SpinLock
+ *
+ *      Спинлок с экспоненциальной паузой: пока занят, только читаем флаг
+ * (не гоняем строку кэша между ядрами), а между попытками ждем все
+ * дольше, под конец отдаем квант
+ *
+ */
+
+struct SpinLock {
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    // пауза внутри цикла ожидания
+    static void pause();
+
+private:
+
+    std::atomic<bool> locked_{false};
+};
+
+inline void SpinLock::pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+inline bool SpinLock::try_lock() {
+    return !locked_.load(std::memory_order_relaxed) &&
+           !locked_.exchange(true, std::memory_order_acquire);
+}
+
+inline void SpinLock::lock() {
+    size_t backoff = 1;
+    while (!try_lock()) {
+        do {
+            if (backoff < 1024) {
+                for (size_t i = 0; i < backoff; i++) {
+                    pause();
+                }
+                backoff *= 2;
+            } else {
+                std::this_thread::yield();
+            }
+        } while (locked_.load(std::memory_order_relaxed));
+    }
+}
+
+inline void SpinLock::unlock() {
+    locked_.store(false, std::memory_order_release);
+}
@@ -0,0 +1,334 @@
+#pragma once
+
+#include "fastallocator.h"
+#include "intrusivelist.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+/*
+ *
+ *      TimerWheel<Callback, Allocator>
+ *
+ *      Иерархическое колесо таймеров. Время - целые тики
+ *
+ *      4 уровня по 256 слотов: на нулевом слот - это один тик, на первом -
+ * 256 тиков, на втором - 65536 и т.д. Таймер кладется в слот того
+ * уровня, куда попадает его срок, так что schedule - O(1). Слот - это
+ * IntrusiveList таймеров, поэтому cancel - просто выцепить узел, тоже
+ * O(1)
+ *
+ *      Когда нулевой уровень проходит круг, очередной слот уровня выше
+ * целиком забирается через splice и его таймеры раскладываются пониже
+ * (каскад). Срабатывает слот тоже целиком: сначала весь слот
+ * перевешивается в отдельный список, потом по нему зовутся колбэки. Из
+ * колбэка можно и ставить, и отменять таймеры
+ *
+ *      Сроки дальше 2^32 тиков ждут в отдельном списке и раз в 2^32 тиков
+ * пробуют встать в колесо
+ *
+ *      Узлы таймеров выделяются через Allocator (по умолчанию
+ * FastAllocator, то есть из FixedAllocator)
+ *
+ */
+
+template <typename Callback = std::function<void()>,
+          typename Allocator = FastAllocator<Callback> >
+struct TimerWheel {
+    /*
+     *  Снаружи это только ручка для cancel: она действительна, пока
+     * таймер не сработал и не отменен
+     */
+    struct Timer : ListBaseHook<> {
+    private:
+        friend struct TimerWheel;
+
+        Timer(uint64_t expires, const Callback &callback)
+                : expires_(expires), callback_(callback) {}
+
+        uint64_t expires_;
+        Callback callback_;
+        IntrusiveList<Timer> *bucket_ = nullptr;
+        size_t level_ = 0;
+    };
+
+    explicit TimerWheel(uint64_t now = 0, const Allocator &alloc = Allocator());
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    Timer *schedule(uint64_t delay, const Callback &callback);
+    Timer *schedule_at(uint64_t tick, const Callback &callback);
+    bool cancel(Timer *timer);
+
+    size_t advance(uint64_t ticks);
+    size_t advance_to(uint64_t tick);
+
+    uint64_t now() const;
+    size_t size() const;
+    bool empty() const;
+
+private:
+    using timer_allocator_type_ =
+        typename PoolRebind<Allocator, Timer>::type;
+    using timer_allocator_traits_ = std::allocator_traits<timer_allocator_type_>;
+
+    static const unsigned level_bits_ = 8;
+    static const size_t slots_ = size_t(1) << level_bits_;
+    static const size_t levels_ = 4;
+
+    void place_(Timer *);
+    void cascade_(size_t level);
+    size_t fire_batch_();
+    void free_timer_(Timer *);
+    void free_list_(IntrusiveList<Timer> &);
+
+    timer_allocator_type_ timer_allocator_;
+
+    IntrusiveList<Timer> wheel_[levels_][slots_];
+    IntrusiveList<Timer> overflow_;
+    IntrusiveList<Timer> firing_;
+
+    // сколько таймеров на каждом уровне, последний - overflow_
+    size_t counts_[levels_ + 1] = {};
+
+    uint64_t now_;
+    size_t size_ = 0;
+};
+
+template <typename Callback, typename Allocator>
+TimerWheel<Callback, Allocator>::TimerWheel(uint64_t now,
+                                            const Allocator &alloc)
+        : timer_allocator_(alloc), now_(now) {}
+
+/*
+ *  Несработавшие таймеры просто удаляются
+ */
+template <typename Callback, typename Allocator>
+TimerWheel<Callback, Allocator>::~TimerWheel() {
+    for (size_t level = 0; level < levels_; level++) {
+        for (size_t slot = 0; slot < slots_; slot++) {
+            free_list_(wheel_[level][slot]);
+        }
+    }
+    free_list_(overflow_);
+    free_list_(firing_);
+}
+
+template <typename Callback, typename Allocator>
+void TimerWheel<Callback, Allocator>::free_timer_(Timer *timer) {
+    timer_allocator_traits_::destroy(timer_allocator_, timer);
+    timer_allocator_traits_::deallocate(timer_allocator_, timer, 1);
+}
+
+template <typename Callback, typename Allocator>
+void TimerWheel<Callback, Allocator>::free_list_(IntrusiveList<Timer> &list) {
+    while (!list.empty()) {
+        Timer *timer = &list.front();
+        list.pop_front();
+        free_timer_(timer);
+    }
+}
+
+/*
+ *  Уровень - по тому, насколько далеко срок, слот - по битам самого
+ * срока. Просроченное кладем в текущий слот нулевого уровня
+ */
+template <typename Callback, typename Allocator>
+void TimerWheel<Callback, Allocator>::place_(Timer *timer) {
+    uint64_t expires = timer->expires_ < now_ ? now_ : timer->expires_;
+    uint64_t delta = expires - now_;
+
+    size_t level = 0;
+    while (level < levels_ &&
+           delta >= (uint64_t(1) << (level_bits_ * (level + 1)))) {
+        level++;
+    }
+
+    IntrusiveList<Timer> *bucket = &overflow_;
+    if (level < levels_) {
+        size_t slot = (expires >> (level_bits_ * level)) & (slots_ - 1);
+        bucket = &wheel_[level][slot];
+    }
+
+    bucket->push_back(*timer);
+    timer->bucket_ = bucket;
+    timer->level_ = level;
+    ++counts_[level];
+}
+
+/*
+ *  Текущий слот уровня level целиком снимаем и раскладываем заново
+ */
+template <typename Callback, typename Allocator>
+void TimerWheel<Callback, Allocator>::cascade_(size_t level) {
+    IntrusiveList<Timer> batch;
+    if (level < levels_) {
+        size_t slot = (now_ >> (level_bits_ * level)) & (slots_ - 1);
+        batch.splice(batch.cend(), wheel_[level][slot]);
+    } else {
+        batch.splice(batch.cend(), overflow_);
+    }
+
+    while (!batch.empty()) {
+        Timer *timer = &batch.front();
+        batch.pop_front();
+        --counts_[level];
+        place_(timer);
+    }
+}
+
+template <typename Callback, typename Allocator>
+typename TimerWheel<Callback, Allocator>::Timer *
+TimerWheel<Callback, Allocator>::schedule(uint64_t delay,
+                                          const Callback &callback) {
+    return schedule_at(now_ + delay, callback);
+}
+
+/*
+ *  Срок не позже now() значит "на следующем тике"
+ */
+template <typename Callback, typename Allocator>
+typename TimerWheel<Callback, Allocator>::Timer *
+TimerWheel<Callback, Allocator>::schedule_at(uint64_t tick,
+                                             const Callback &callback) {
+    if (tick <= now_) {
+        tick = now_ + 1;
+    }
+
+    Timer *timer = timer_allocator_traits_::allocate(timer_allocator_, 1);
+    try {
+        ::new (static_cast<void *>(timer)) Timer(tick, callback);
+    } catch (...) {
+        timer_allocator_traits_::deallocate(timer_allocator_, timer, 1);
+        throw;
+    }
+
+    place_(timer);
+    ++size_;
+    return timer;
+}
+
+/*
+ *  false - таймер уже срабатывает прямо сейчас (отменяют из его же
+ * колбэка). После срабатывания ручка недействительна, как итератор
+ * на удаленный элемент List
+ */
+template <typename Callback, typename Allocator>
+bool TimerWheel<Callback, Allocator>::cancel(Timer *timer) {
+    if (timer->bucket_ == nullptr) {
+        return false;
+    }
+
+    if (timer->bucket_ != &firing_) {
+        --counts_[timer->level_];
+    }
+    timer->bucket_->erase(*timer);
+    free_timer_(timer);
+    --size_;
+    return true;
+}
+
+/*
+ *  Все, что лежит в firing_, по очереди. Пока колбэк работает, узел уже
+ * снят со слота (cancel на нем вернет false), освобождается он сразу
+ * после вызова. Если колбэк бросит исключение, остальное останется в
+ * firing_ и сработает при следующем advance
+ */
+template <typename Callback, typename Allocator>
+size_t TimerWheel<Callback, Allocator>::fire_batch_() {
+    size_t fired = 0;
+    while (!firing_.empty()) {
+        Timer *timer = &firing_.front();
+        firing_.pop_front();
+        timer->bucket_ = nullptr;
+        --size_;
+        ++fired;
+
+        try {
+            timer->callback_();
+        } catch (...) {
+            free_timer_(timer);
+            throw;
+        }
+        free_timer_(timer);
+    }
+    return fired;
+}
+
+template <typename Callback, typename Allocator>
+size_t TimerWheel<Callback, Allocator>::advance(uint64_t ticks) {
+    return advance_to(now_ + ticks);
+}
+
+/*
+ *  Идем по тикам. На каждом тике: если младший уровень прошел круг -
+ * каскад сверху, потом весь текущий слот нулевого уровня срабатывает
+ *
+ *  Если нижние уровни пусты, до ближайшего каскада ничего не случится:
+ * туда и прыгаем, а пустое колесо проматываем сразу до tick
+ */
+template <typename Callback, typename Allocator>
+size_t TimerWheel<Callback, Allocator>::advance_to(uint64_t tick) {
+    size_t fired = fire_batch_();
+
+    while (now_ < tick) {
+        if (size_ == 0) {
+            now_ = tick;
+            break;
+        }
+
+        size_t lowest = 0;
+        while (counts_[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest > 0) {
+            uint64_t span = uint64_t(1) << (level_bits_ * lowest);
+            uint64_t next = (now_ | (span - 1)) + 1;
+            if (next > tick) {
+                now_ = tick;
+                break;
+            }
+            now_ = next - 1;
+        }
+
+        ++now_;
+        for (size_t level = 1; level <= levels_; level++) {
+            uint64_t mask = (uint64_t(1) << (level_bits_ * level)) - 1;
+            if ((now_ & mask) != 0) {
+                break;
+            }
+            cascade_(level);
+        }
+
+        IntrusiveList<Timer> &slot = wheel_[0][now_ & (slots_ - 1)];
+        if (slot.empty()) {
+            continue;
+        }
+
+        firing_.splice(firing_.cend(), slot);
+        for (auto it = firing_.begin(); it != firing_.end(); ++it) {
+            it->bucket_ = &firing_;
+            --counts_[0];
+        }
+        fired += fire_batch_();
+    }
+    return fired;
+}
+
+template <typename Callback, typename Allocator>
+uint64_t TimerWheel<Callback, Allocator>::now() const {
+    return now_;
+}
+
+template <typename Callback, typename Allocator>
+size_t TimerWheel<Callback, Allocator>::size() const {
+    return size_;
+}
+
+template <typename Callback, typename Allocator>
+bool TimerWheel<Callback, Allocator>::empty() const {
+    return size_ == 0;
+}
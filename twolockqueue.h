@@ -0,0 +1,345 @@
+#pragma once
+
+#include "concurrentallocator.h"
+#include "spinlock.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/*
+ *
+ *      TwoLockQueue<T, Allocator>
+ *
+ *      Очередь Michael-Scott с двумя замками: добавляют в хвост под одним
+ * спинлоком, забирают из головы под другим, так что писатели и читатели
+ * друг другу не мешают
+ *
+ *      Как в List, в голове стоит фиктивный узел без значения. Забирая
+ * элемент, читатель переносит значение из следующего узла, и уже этот
+ * узел становится фиктивным, а старый освобождается. Голова и хвост
+ * никогда не указывают на один и тот же живой элемент, поэтому замкам не
+ * нужно знать друг о друге
+ *
+ *      Голова и хвост вместе со своими замками лежат в разных строках
+ * кэша
+ *
+ *      pop ждет, если пусто. Будить спящих писатели идут только когда
+ * спящие есть, а push_range будит всех один раз на всю пачку
+ *
+ *      Узлы выделяются одними потоками и освобождаются другими, поэтому
+ * по умолчанию ConcurrentFastAllocator
+ *
+ */
+
+template <typename T, typename Allocator = ConcurrentFastAllocator<T> >
+struct TwoLockQueue {
+private:
+    struct Node {
+        std::atomic<Node *> next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+
+        Node() : next(nullptr) {}
+
+        T *elem() {
+            return reinterpret_cast<T *>(&storage_);
+        }
+    };
+
+public:
+    explicit TwoLockQueue(const Allocator &alloc = Allocator());
+    ~TwoLockQueue();
+
+    TwoLockQueue(const TwoLockQueue &) = delete;
+    TwoLockQueue &operator=(const TwoLockQueue &) = delete;
+
+    void push(const T &value);
+    template <typename InputIt>
+    void push_range(InputIt first, InputIt last);
+
+    bool try_pop(T &out);
+    template <typename OutputIt>
+    size_t try_pop_batch(OutputIt out, size_t max_count);
+
+    bool pop(T &out);
+    void close();
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    using node_allocator_type_ =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    static const size_t spin_tries_ = 64;
+
+    Node *new_node_();
+    Node *new_node_(const T &value);
+    void free_node_(Node *);
+
+    void link_(Node *first, Node *last, size_t count);
+    void wake_(size_t count);
+
+    node_allocator_type_ node_allocator_;
+
+    struct alignas(64) {
+        SpinLock lock;
+        Node *node;
+    } head_;
+
+    struct alignas(64) {
+        SpinLock lock;
+        Node *node;
+    } tail_;
+
+    alignas(64) std::atomic<size_t> size_{0};
+    std::atomic<size_t> waiters_{0};
+    std::atomic<bool> closed_{false};
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+};
+
+template <typename T, typename Allocator>
+TwoLockQueue<T, Allocator>::TwoLockQueue(const Allocator &alloc)
+        : node_allocator_(alloc) {
+    Node *dummy = new_node_();
+    head_.node = tail_.node = dummy;
+}
+
+/*
+ *  Других потоков к этому моменту быть не должно
+ */
+template <typename T, typename Allocator>
+TwoLockQueue<T, Allocator>::~TwoLockQueue() {
+    Node *node = head_.node->next.load(std::memory_order_relaxed);
+    free_node_(head_.node);
+    while (node) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        node->elem()->~T();
+        free_node_(node);
+        node = next;
+    }
+}
+
+template <typename T, typename Allocator>
+typename TwoLockQueue<T, Allocator>::Node *
+TwoLockQueue<T, Allocator>::new_node_() {
+    Node *node = node_allocator_traits_::allocate(node_allocator_, 1);
+    node_allocator_traits_::construct(node_allocator_, node);
+    return node;
+}
+
+template <typename T, typename Allocator>
+typename TwoLockQueue<T, Allocator>::Node *
+TwoLockQueue<T, Allocator>::new_node_(const T &value) {
+    Node *node = new_node_();
+    try {
+        new (node->elem()) T(value);
+    } catch (...) {
+        free_node_(node);
+        throw;
+    }
+    return node;
+}
+
+/*
+ *  Значение к этому моменту уже уничтожено (или его не было)
+ */
+template <typename T, typename Allocator>
+void TwoLockQueue<T, Allocator>::free_node_(Node *node) {
+    node_allocator_traits_::destroy(node_allocator_, node);
+    node_allocator_traits_::deallocate(node_allocator_, node, 1);
+}
+
+/*
+ *  Готовую цепочку - в хвост под замком хвоста, выделение памяти было
+ * до замка
+ */
+template <typename T, typename Allocator>
+void TwoLockQueue<T, Allocator>::link_(Node *first, Node *last, size_t count) {
+    // до публикации, чтобы size() не уходил в минус
+    size_.fetch_add(count, std::memory_order_relaxed);
+    {
+        std::lock_guard<SpinLock> lock(tail_.lock);
+        tail_.node->next.store(first, std::memory_order_release);
+        tail_.node = last;
+    }
+    wake_(count);
+}
+
+/*
+ *  Барьер в паре с увеличением waiters_ в pop: либо мы видим спящего,
+ * либо он после увеличения видит наш узел
+ */
+template <typename T, typename Allocator>
+void TwoLockQueue<T, Allocator>::wake_(size_t count) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t waiters = waiters_.load(std::memory_order_relaxed);
+    if (waiters == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    if (count == 1 || waiters == 1) {
+        wakeup_.notify_one();
+    } else {
+        wakeup_.notify_all();
+    }
+}
+
+template <typename T, typename Allocator>
+void TwoLockQueue<T, Allocator>::push(const T &value) {
+    Node *node = new_node_(value);
+    link_(node, node, 1);
+}
+
+/*
+ *  Вся пачка - один захват замка хвоста и одно пробуждение
+ */
+template <typename T, typename Allocator>
+template <typename InputIt>
+void TwoLockQueue<T, Allocator>::push_range(InputIt first, InputIt last) {
+    Node *chain_first = nullptr;
+    Node *chain_last = nullptr;
+    size_t count = 0;
+
+    try {
+        for (; first != last; ++first) {
+            Node *node = new_node_(*first);
+            if (chain_last) {
+                chain_last->next.store(node, std::memory_order_relaxed);
+            } else {
+                chain_first = node;
+            }
+            chain_last = node;
+            ++count;
+        }
+    } catch (...) {
+        while (chain_first) {
+            Node *next = chain_first->next.load(std::memory_order_relaxed);
+            chain_first->elem()->~T();
+            free_node_(chain_first);
+            chain_first = next;
+        }
+        throw;
+    }
+
+    if (count > 0) {
+        link_(chain_first, chain_last, count);
+    }
+}
+
+template <typename T, typename Allocator>
+bool TwoLockQueue<T, Allocator>::try_pop(T &out) {
+    Node *old;
+    {
+        std::lock_guard<SpinLock> lock(head_.lock);
+        old = head_.node;
+        Node *next = old->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+
+        out = std::move(*next->elem());
+        next->elem()->~T();
+        head_.node = next;
+    }
+
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    free_node_(old);
+    return true;
+}
+
+/*
+ *  До max_count элементов за один захват замка головы
+ */
+template <typename T, typename Allocator>
+template <typename OutputIt>
+size_t TwoLockQueue<T, Allocator>::try_pop_batch(OutputIt out,
+                                                 size_t max_count) {
+    Node *old;
+    size_t count = 0;
+    {
+        std::lock_guard<SpinLock> lock(head_.lock);
+        old = head_.node;
+        Node *node = old;
+        while (count < max_count) {
+            Node *next = node->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                break;
+            }
+            *out++ = std::move(*next->elem());
+            next->elem()->~T();
+            node = next;
+            ++count;
+        }
+        head_.node = node;
+    }
+
+    size_.fetch_sub(count, std::memory_order_relaxed);
+
+    // освобождаем все бывшие фиктивные узлы, кроме новой головы
+    for (size_t i = 0; i < count; i++) {
+        Node *next = old->next.load(std::memory_order_relaxed);
+        free_node_(old);
+        old = next;
+    }
+    return count;
+}
+
+/*
+ *  Сначала немного крутимся, потом засыпаем
+ *  false - очередь закрыта и пуста
+ */
+template <typename T, typename Allocator>
+bool TwoLockQueue<T, Allocator>::pop(T &out) {
+    for (size_t i = 0; i < spin_tries_; i++) {
+        if (try_pop(out)) {
+            return true;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    while (true) {
+        if (try_pop(out)) {
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (closed_.load(std::memory_order_acquire)) {
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        wakeup_.wait(lock);
+    }
+}
+
+/*
+ *  Будит всех ждущих, pop на пустой закрытой очереди возвращает false
+ */
+template <typename T, typename Allocator>
+void TwoLockQueue<T, Allocator>::close() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        closed_.store(true, std::memory_order_release);
+    }
+    wakeup_.notify_all();
+}
+
+template <typename T, typename Allocator>
+size_t TwoLockQueue<T, Allocator>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator>
+bool TwoLockQueue<T, Allocator>::empty() const {
+    return size() == 0;
+}
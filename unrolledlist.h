@@ -0,0 +1,587 @@
+#pragma once
+
+#include "fastallocator.h"
+
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/*
+ *
+ *      UnrolledList<T, N, Allocator>
+ *
+ *      Развернутый список: в каждом узле лежит до N элементов подряд, так
+ * что на элемент приходится не два указателя, а 2/N, и по нескольку
+ * элементов читается за один кэш-промах
+ *
+ *      Вставка в полный узел делит его пополам, удаление из полупустого
+ * узла сливает его со следующим, если влезает
+ *
+ *      Интерфейс как у List. Итераторы - это (узел, номер в узле), поэтому
+ * вставка и удаление сдвигают соседей по узлу и портят итераторы на них
+ *
+ *      Узлы выделяются через Allocator, с FastAllocator они попадают в
+ * FixedAllocator своего размера, даже если узел крупнее maxSize (см.
+ * PoolRebind)
+ *
+ */
+
+template <typename T, size_t N = 16, typename Allocator = std::allocator<T> >
+struct UnrolledList {
+    static_assert(N >= 2, "UnrolledList needs at least two elements per node");
+
+public:
+    explicit UnrolledList(const Allocator &alloc = Allocator());
+    UnrolledList(size_t count, const T &value,
+                 const Allocator &alloc = Allocator());
+    UnrolledList(size_t count);
+    UnrolledList(const UnrolledList &rhs);
+    UnrolledList &operator=(const UnrolledList &rhs);
+    ~UnrolledList();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    void pop_front();
+    void pop_back();
+
+    void push_front(const T &value);
+    void push_back(const T &value);
+
+    Allocator &get_allocator();
+
+    template <typename U>
+    class unrolled_iterator;
+
+    typedef unrolled_iterator<T> iterator;
+    typedef unrolled_iterator<T const> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    iterator insert(const_iterator, const T &);
+    iterator erase(const_iterator);
+
+    const_iterator find(const T &) const;
+    size_t count(const T &) const;
+
+private:
+    struct Node {
+        Node *next;
+        Node *prev;
+        size_t count;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type elems_[N];
+
+        T *elem(size_t index) { return reinterpret_cast<T *>(&elems_[index]); }
+    };
+
+    using allocator_traits_ = std::allocator_traits<Allocator>;
+    using node_allocator_type_ =
+        typename PoolRebind<Allocator, Node>::type;
+    using node_allocator_traits_ = std::allocator_traits<node_allocator_type_>;
+
+    Node *create_node_after_(Node *);
+    void destroy_node_(Node *);
+
+    void split_(Node *);
+    void merge_next_(Node *);
+    void shift_right_(Node *, size_t index);
+
+    void copy_(const UnrolledList &);
+
+    Allocator allocator_;
+    node_allocator_type_ node_allocator_;
+    size_t size_ = 0;
+
+    // один сентинел, список закольцован через него
+    Node *head_ = nullptr;
+};
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator>::UnrolledList(const Allocator &alloc)
+        : allocator_(std::allocator_traits<Allocator>::
+                         select_on_container_copy_construction(alloc)) {
+    head_ = node_allocator_traits_::allocate(node_allocator_, 1);
+    head_->next = head_->prev = head_;
+    head_->count = 0;
+}
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator>::UnrolledList(size_t count, const T &value,
+                                            const Allocator &alloc)
+        : UnrolledList(alloc) {
+    for (size_t i = 0; i < count; i++) {
+        push_back(value);
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator>::UnrolledList(size_t count)
+        : UnrolledList(Allocator()) {
+    for (size_t i = 0; i < count; i++) {
+        push_back(T());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator>::UnrolledList(const UnrolledList &rhs)
+        : UnrolledList(rhs.allocator_) {
+    copy_(rhs);
+}
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator> &UnrolledList<T, N, Allocator>::operator=(
+    const UnrolledList &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+
+    if (std::allocator_traits<Allocator>::
+            propagate_on_container_copy_assignment::value) {
+        allocator_ = rhs.allocator_;
+    }
+
+    copy_(rhs);
+
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+UnrolledList<T, N, Allocator>::~UnrolledList() {
+    clear();
+    node_allocator_traits_::deallocate(node_allocator_, head_, 1);
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::copy_(const UnrolledList &rhs) {
+    for (auto it = rhs.cbegin(); it != rhs.cend(); ++it) {
+        push_back(*it);
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+size_t UnrolledList<T, N, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, size_t N, typename Allocator>
+bool UnrolledList<T, N, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::clear() {
+    while (head_->next != head_) {
+        Node *node = head_->next;
+        for (size_t i = 0; i < node->count; i++) {
+            allocator_traits_::destroy(allocator_, node->elem(i));
+        }
+        destroy_node_(node);
+    }
+    size_ = 0;
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::pop_front() {
+    if (size_) {
+        erase(begin());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::pop_back() {
+    if (size_) {
+        erase(--end());
+    }
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::push_front(const T &value) {
+    insert(begin(), value);
+}
+
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::push_back(const T &value) {
+    insert(end(), value);
+}
+
+template <typename T, size_t N, typename Allocator>
+Allocator &UnrolledList<T, N, Allocator>::get_allocator() {
+    return allocator_;
+}
+
+/*
+ *  Пустой узел сразу после ptr
+ */
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::Node *
+UnrolledList<T, N, Allocator>::create_node_after_(Node *ptr) {
+    Node *newbie = node_allocator_traits_::allocate(node_allocator_, 1);
+    newbie->count = 0;
+
+    newbie->prev = ptr;
+    newbie->next = ptr->next;
+    ptr->next->prev = newbie;
+    ptr->next = newbie;
+
+    return newbie;
+}
+
+/*
+ *  Элементы к этому моменту уже должны быть разрушены или перенесены
+ */
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::destroy_node_(Node *ptr) {
+    ptr->prev->next = ptr->next;
+    ptr->next->prev = ptr->prev;
+    node_allocator_traits_::deallocate(node_allocator_, ptr, 1);
+}
+
+/*
+ *  Верхнюю половину полного узла переносим в новый узел после него
+ */
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::split_(Node *ptr) {
+    Node *newbie = create_node_after_(ptr);
+
+    size_t keep = ptr->count / 2;
+    for (size_t i = keep; i < ptr->count; i++) {
+        allocator_traits_::construct(allocator_, newbie->elem(i - keep),
+                                     std::move(*ptr->elem(i)));
+        allocator_traits_::destroy(allocator_, ptr->elem(i));
+    }
+
+    newbie->count = ptr->count - keep;
+    ptr->count = keep;
+}
+
+/*
+ *  Переносим все элементы следующего узла в конец ptr
+ */
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::merge_next_(Node *ptr) {
+    Node *next = ptr->next;
+    for (size_t i = 0; i < next->count; i++) {
+        allocator_traits_::construct(allocator_, ptr->elem(ptr->count + i),
+                                     std::move(*next->elem(i)));
+        allocator_traits_::destroy(allocator_, next->elem(i));
+    }
+
+    ptr->count += next->count;
+    destroy_node_(next);
+}
+
+/*
+ *  Вставка перед iter
+ *  - в конец: дописываем в последний узел, если в нем есть место
+ *  - в начало узла: дописываем в конец предыдущего, если в нем есть место
+ *  - иначе, если узел полный, сначала делим его пополам, и сдвигаем хвост
+ *    узла на одну позицию вправо
+ *  В последнем случае value может лежать в этом же узле, а split_ и сдвиг
+ * его переносят, поэтому сначала делаем копию
+ */
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::iterator
+UnrolledList<T, N, Allocator>::insert(const_iterator iter, const T &value) {
+    Node *node = iter.node_;
+    size_t index = iter.index_;
+
+    if (node == head_) {
+        node = head_->prev;
+        if (node == head_ || node->count == N) {
+            node = create_node_after_(node);
+        }
+        index = node->count;
+        allocator_traits_::construct(allocator_, node->elem(index), value);
+    } else if (index == 0 && node->prev != head_ && node->prev->count < N) {
+        node = node->prev;
+        index = node->count;
+        allocator_traits_::construct(allocator_, node->elem(index), value);
+    } else {
+        T copy(value);
+        if (node->count == N) {
+            split_(node);
+            if (index > node->count) {
+                index -= node->count;
+                node = node->next;
+            }
+        }
+        if (index == node->count) {
+            allocator_traits_::construct(allocator_, node->elem(index),
+                                         std::move(copy));
+        } else {
+            shift_right_(node, index);
+            *node->elem(index) = std::move(copy);
+        }
+    }
+
+    node->count++;
+    size_++;
+
+    return iterator(node, index);
+}
+
+/*
+ *  Освобождаем место index в узле: хвост уезжает на одну позицию вправо.
+ * Место остается сконструированным (из него сделали move), count не
+ * меняется
+ */
+template <typename T, size_t N, typename Allocator>
+void UnrolledList<T, N, Allocator>::shift_right_(Node *node, size_t index) {
+    allocator_traits_::construct(allocator_, node->elem(node->count),
+                                 std::move(*node->elem(node->count - 1)));
+    for (size_t i = node->count - 1; i > index; i--) {
+        *node->elem(i) = std::move(*node->elem(i - 1));
+    }
+}
+
+/*
+ *  Удаляем элемент, сдвигая хвост узла влево
+ *  Пустой узел освобождаем, а полупустой сливаем со следующим, если
+ * вместе они помещаются в один узел
+ */
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::iterator
+UnrolledList<T, N, Allocator>::erase(const_iterator iter) {
+    Node *node = iter.node_;
+    size_t index = iter.index_;
+
+    for (size_t i = index; i + 1 < node->count; i++) {
+        *node->elem(i) = std::move(*node->elem(i + 1));
+    }
+    allocator_traits_::destroy(allocator_, node->elem(node->count - 1));
+    node->count--;
+    size_--;
+
+    if (node->count == 0) {
+        Node *next = node->next;
+        destroy_node_(node);
+        return iterator(next, 0);
+    }
+
+    Node *next = node->next;
+    if (node->count < N / 2 && next != head_ && node->count + next->count <= N) {
+        merge_next_(node);
+    }
+
+    if (index < node->count) {
+        return iterator(node, index);
+    }
+    return iterator(node->next, 0);
+}
+
+/*
+ *  Внутри узла элементы лежат подряд, так что сравнение по узлу -
+ * плотный цикл, который компилятор может векторизовать
+ */
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::const_iterator
+UnrolledList<T, N, Allocator>::find(const T &value) const {
+    for (Node *node = head_->next; node != head_; node = node->next) {
+        const T *elems = node->elem(0);
+        size_t count = node->count;
+
+        bool found = false;
+        for (size_t i = 0; i < count; i++) {
+            found |= elems[i] == value;
+        }
+        if (!found) {
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (elems[i] == value) {
+                return const_iterator(node, i);
+            }
+        }
+    }
+    return cend();
+}
+
+template <typename T, size_t N, typename Allocator>
+size_t UnrolledList<T, N, Allocator>::count(const T &value) const {
+    size_t result = 0;
+    for (Node *node = head_->next; node != head_; node = node->next) {
+        const T *elems = node->elem(0);
+        size_t count = node->count;
+
+        for (size_t i = 0; i < count; i++) {
+            result += elems[i] == value ? 1 : 0;
+        }
+    }
+    return result;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+class UnrolledList<T, N, Allocator>::unrolled_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename std::remove_const<U>::type;
+    using pointer = U *;
+    using reference = U &;
+
+    unrolled_iterator() = default;
+    unrolled_iterator(const unrolled_iterator<typename std::remove_const<T>::type> &rhs);
+    unrolled_iterator &operator=(const unrolled_iterator &rhs) = default;
+
+    U &operator*() const;
+    U *operator->() const;
+
+    unrolled_iterator &operator++();
+    unrolled_iterator operator++(int);
+    unrolled_iterator &operator--();
+    unrolled_iterator operator--(int);
+
+    bool operator==(const unrolled_iterator<U> &rhs) const;
+    bool operator!=(const unrolled_iterator<U> &rhs) const;
+    friend struct UnrolledList<T, N, Allocator>;
+    friend class unrolled_iterator<T const>;
+
+private:
+    unrolled_iterator(Node *node, size_t index);
+
+    Node *node_ = nullptr;
+    size_t index_ = 0;
+};
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::unrolled_iterator(
+    Node *node, size_t index)
+        : node_(node), index_(index) {}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::unrolled_iterator(
+    const unrolled_iterator<typename std::remove_const<T>::type> &rhs)
+        : node_(rhs.node_), index_(rhs.index_) {}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+U &UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator*() const {
+    return *node_->elem(index_);
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+U *UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator->() const {
+    return node_->elem(index_);
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename UnrolledList<T, N, Allocator>::template unrolled_iterator<U> &
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator++() {
+    if (++index_ >= node_->count) {
+        node_ = node_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename UnrolledList<T, N, Allocator>::template unrolled_iterator<U>
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator++(int) {
+    unrolled_iterator other = *this;
+    ++(*this);
+    return other;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename UnrolledList<T, N, Allocator>::template unrolled_iterator<U> &
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator--() {
+    if (index_ == 0) {
+        node_ = node_->prev;
+        index_ = node_->count;
+    }
+    --index_;
+    return *this;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+typename UnrolledList<T, N, Allocator>::template unrolled_iterator<U>
+UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator--(int) {
+    unrolled_iterator other = *this;
+    --(*this);
+    return other;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+bool UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator==(
+    const unrolled_iterator<U> &rhs) const {
+    return node_ == rhs.node_ && index_ == rhs.index_;
+}
+
+template <typename T, size_t N, typename Allocator>
+template <typename U>
+bool UnrolledList<T, N, Allocator>::unrolled_iterator<U>::operator!=(
+    const unrolled_iterator<U> &rhs) const {
+    return !(*this == rhs);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::iterator
+UnrolledList<T, N, Allocator>::begin() const {
+    return iterator(head_->next, 0);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::const_iterator
+UnrolledList<T, N, Allocator>::cbegin() const {
+    return const_iterator(head_->next, 0);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::iterator
+UnrolledList<T, N, Allocator>::end() const {
+    return iterator(head_, 0);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::const_iterator
+UnrolledList<T, N, Allocator>::cend() const {
+    return const_iterator(head_, 0);
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::reverse_iterator
+UnrolledList<T, N, Allocator>::rbegin() const {
+    return reverse_iterator(end());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::const_reverse_iterator
+UnrolledList<T, N, Allocator>::crbegin() const {
+    return const_reverse_iterator(cend());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::reverse_iterator
+UnrolledList<T, N, Allocator>::rend() const {
+    return reverse_iterator(begin());
+}
+
+template <typename T, size_t N, typename Allocator>
+typename UnrolledList<T, N, Allocator>::const_reverse_iterator
+UnrolledList<T, N, Allocator>::crend() const {
+    return const_reverse_iterator(cbegin());
+}